@@ -0,0 +1,96 @@
+#ifndef BODY_STORE_H
+#define BODY_STORE_H
+
+#include <vector>
+#include "../math.h"
+#include "../rotation.h"
+
+/*  NOTE: Body store
+    RigidBody is a fat struct, its shape alone carries two vertex pointers, so looping
+    over world->bodies to integrate pulls whole cache lines in for a handful of floats.
+    Once a body is added to a world the state the step touches every frame lives here,
+    one array per field, and index i is the same body as world->bodies[i]. The RigidBody
+    keeps the cold data: shape, material, broadphase proxy and debug info.
+*/
+
+enum BodyFlags
+{
+    BODY_SLEEPING = 1 << 0,
+    BODY_FREEZE_ORIENTATION = 1 << 1,
+};
+
+struct BodyStore
+{
+    std::vector<Vector3> position;
+    std::vector<Vector3> velocity;
+    std::vector<Angular> angular_velocity;
+    std::vector<Rotation> orientation;
+
+    std::vector<Vector3> force;
+    std::vector<Angular> torque;
+
+    std::vector<float> inverse_mass;
+    std::vector<InverseInertia> inverse_inertia;
+
+    std::vector<u32> flags;
+    std::vector<float> sleep_time;
+
+    int count;
+};
+
+void init_body_store(BodyStore* store)
+{
+    store->position.clear();
+    store->velocity.clear();
+    store->angular_velocity.clear();
+    store->orientation.clear();
+    store->force.clear();
+    store->torque.clear();
+    store->inverse_mass.clear();
+    store->inverse_inertia.clear();
+    store->flags.clear();
+    store->sleep_time.clear();
+    store->count = 0;
+}
+
+int body_store_add(BodyStore* store, Vector3 position, Vector3 velocity, Rotation orientation, Angular angular_velocity,
+                   float inverse_mass, InverseInertia inverse_inertia, u32 flags)
+{
+    store->position.push_back(position);
+    store->velocity.push_back(velocity);
+    store->angular_velocity.push_back(angular_velocity);
+    store->orientation.push_back(orientation);
+    store->force.push_back({});
+    store->torque.push_back({});
+    store->inverse_mass.push_back(inverse_mass);
+    store->inverse_inertia.push_back(inverse_inertia);
+    store->flags.push_back(flags);
+    store->sleep_time.push_back(0);
+
+    return store->count++;
+}
+
+inline bool is_sleeping(BodyStore* store, int body)
+{
+    return (store->flags[body] & BODY_SLEEPING) != 0;
+}
+
+//NOTE: Static bodies never move and sleeping ones are skipped by the step
+inline bool is_active(BodyStore* store, int body)
+{
+    return store->inverse_mass[body] != 0 && !is_sleeping(store, body);
+}
+
+//NOTE: The solver treats a frozen orientation as infinite inertia, impulses only move the body
+inline bool can_rotate(BodyStore* store, int body)
+{
+    return store->inverse_mass[body] != 0 && !(store->flags[body] & BODY_FREEZE_ORIENTATION);
+}
+
+inline void wake_body(BodyStore* store, int body)
+{
+    store->flags[body] &= ~BODY_SLEEPING;
+    store->sleep_time[body] = 0;
+}
+
+#endif
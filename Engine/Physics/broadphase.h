@@ -0,0 +1,486 @@
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <vector>
+#include <algorithm>
+#include "../shape.h"
+
+#define AABB_TREE_NULL_NODE -1
+#define AABB_TREE_STACK_SIZE 256
+
+//NOTE: Fat AABBs are inflated by this margin (world units) so small movements don't
+//      force a remove + reinsert of the proxy every step
+#define AABB_FAT_MARGIN 5.0f
+#define AABB_DISPLACEMENT_MULTIPLIER 2.0f
+
+//NOTE: Candidate pair for the narrowphase, a is always the lower body index
+struct BroadphasePair
+{
+    int a;
+    int b;
+};
+
+struct AABBTreeNode
+{
+    AABB box;
+
+    //NOTE: parent doubles as the next pointer while the node is in the free list
+    int parent;
+    int left;
+    int right;
+
+    //NOTE: leaf = 0, free node = -1
+    int height;
+    int body_index;
+};
+
+struct AABBTree
+{
+    std::vector<AABBTreeNode> nodes;
+    int root;
+    int free_list;
+};
+
+inline bool aabb_contains(AABB a, AABB b)
+{
+    return a.min.x <= b.min.x && a.min.y <= b.min.y &&
+           b.max.x <= a.max.x && b.max.y <= a.max.y;
+}
+
+inline AABB aabb_union(AABB a, AABB b)
+{
+    AABB result;
+    result.min = V2(min(a.min.x, b.min.x), min(a.min.y, b.min.y));
+    result.max = V2(max(a.max.x, b.max.x), max(a.max.y, b.max.y));
+    return result;
+}
+
+inline float aabb_perimeter(AABB a)
+{
+    return 2.0f * ((a.max.x - a.min.x) + (a.max.y - a.min.y));
+}
+
+inline u64 pair_key(int a, int b)
+{
+    if(a > b)
+    {
+        int t = a;
+        a = b;
+        b = t;
+    }
+    return ((u64)(u32)a << 32) | (u64)(u32)b;
+}
+
+inline BroadphasePair pair_from_key(u64 key)
+{
+    BroadphasePair pair = {(int)(key >> 32), (int)(key & 0xFFFFFFFF)};
+    return pair;
+}
+
+bool pair_less(BroadphasePair a, BroadphasePair b)
+{
+    return a.a < b.a || (a.a == b.a && a.b < b.b);
+}
+
+inline bool operator==(BroadphasePair a, BroadphasePair b)
+{
+    return a.a == b.a && a.b == b.b;
+}
+
+void sort_pairs(std::vector<BroadphasePair>* pairs)
+{
+    std::sort(pairs->begin(), pairs->end(), pair_less);
+}
+
+//NOTE: Reference implementation, tests every pair of boxes. Only used to verify the
+//      other broadphases produce the same candidates
+void find_pairs_brute_force(AABB* boxes, int count, std::vector<BroadphasePair>* pairs)
+{
+    pairs->clear();
+    for(int i = 0; i < count; ++i)
+    {
+        for(int j = i + 1; j < count; ++j)
+        {
+            if(aabb_overlap(boxes[i], boxes[j]))
+            {
+                pairs->push_back({i, j});
+            }
+        }
+    }
+}
+
+/*  NOTE: Dynamic AABB tree
+    Every body owns a leaf (proxy) holding its fattened AABB. Internal nodes hold
+    the union of their children. Insertion picks the sibling with the cheapest
+    perimeter increase and the tree is kept balanced with rotations, same idea as
+    Box2D's b2DynamicTree.
+    Reference: https://box2d.org/files/ErinCatto_DynamicBVH_GDC2019.pdf
+*/
+
+void init_aabb_tree(AABBTree* tree)
+{
+    tree->nodes.clear();
+    tree->root = AABB_TREE_NULL_NODE;
+    tree->free_list = AABB_TREE_NULL_NODE;
+}
+
+inline bool is_leaf(AABBTreeNode* node)
+{
+    return node->left == AABB_TREE_NULL_NODE;
+}
+
+int allocate_node(AABBTree* tree)
+{
+    if(tree->free_list == AABB_TREE_NULL_NODE)
+    {
+        AABBTreeNode node = {};
+        node.height = -1;
+        tree->nodes.push_back(node);
+        tree->free_list = (int)tree->nodes.size() - 1;
+        tree->nodes[tree->free_list].parent = AABB_TREE_NULL_NODE;
+    }
+
+    int index = tree->free_list;
+    AABBTreeNode* node = &tree->nodes[index];
+    tree->free_list = node->parent;
+
+    node->parent = AABB_TREE_NULL_NODE;
+    node->left = AABB_TREE_NULL_NODE;
+    node->right = AABB_TREE_NULL_NODE;
+    node->height = 0;
+    node->body_index = -1;
+
+    return index;
+}
+
+void free_node(AABBTree* tree, int index)
+{
+    tree->nodes[index].parent = tree->free_list;
+    tree->nodes[index].height = -1;
+    tree->free_list = index;
+}
+
+void fix_node(AABBTree* tree, int index)
+{
+    AABBTreeNode* node = &tree->nodes[index];
+    AABBTreeNode* left = &tree->nodes[node->left];
+    AABBTreeNode* right = &tree->nodes[node->right];
+
+    node->height = 1 + max(left->height, right->height);
+    node->box = aabb_union(left->box, right->box);
+}
+
+//NOTE: Rotates node a up if it is imbalanced, returns the new root of the subtree
+int balance_node(AABBTree* tree, int index_a)
+{
+    AABBTreeNode* a = &tree->nodes[index_a];
+    if(is_leaf(a) || a->height < 2)
+    {
+        return index_a;
+    }
+
+    int index_b = a->left;
+    int index_c = a->right;
+    AABBTreeNode* b = &tree->nodes[index_b];
+    AABBTreeNode* c = &tree->nodes[index_c];
+
+    int balance = c->height - b->height;
+
+    //NOTE: Rotate c up
+    if(balance > 1)
+    {
+        int index_f = c->left;
+        int index_g = c->right;
+        AABBTreeNode* f = &tree->nodes[index_f];
+        AABBTreeNode* g = &tree->nodes[index_g];
+
+        c->left = index_a;
+        c->parent = a->parent;
+        a->parent = index_c;
+
+        if(c->parent != AABB_TREE_NULL_NODE)
+        {
+            AABBTreeNode* parent = &tree->nodes[c->parent];
+            if(parent->left == index_a) parent->left = index_c;
+            else parent->right = index_c;
+        }
+        else
+        {
+            tree->root = index_c;
+        }
+
+        if(f->height > g->height)
+        {
+            c->right = index_f;
+            a->right = index_g;
+            g->parent = index_a;
+        }
+        else
+        {
+            c->right = index_g;
+            a->right = index_f;
+            f->parent = index_a;
+        }
+
+        fix_node(tree, index_a);
+        fix_node(tree, index_c);
+
+        return index_c;
+    }
+
+    //NOTE: Rotate b up
+    if(balance < -1)
+    {
+        int index_d = b->left;
+        int index_e = b->right;
+        AABBTreeNode* d = &tree->nodes[index_d];
+        AABBTreeNode* e = &tree->nodes[index_e];
+
+        b->left = index_a;
+        b->parent = a->parent;
+        a->parent = index_b;
+
+        if(b->parent != AABB_TREE_NULL_NODE)
+        {
+            AABBTreeNode* parent = &tree->nodes[b->parent];
+            if(parent->left == index_a) parent->left = index_b;
+            else parent->right = index_b;
+        }
+        else
+        {
+            tree->root = index_b;
+        }
+
+        if(d->height > e->height)
+        {
+            b->right = index_d;
+            a->left = index_e;
+            e->parent = index_a;
+        }
+        else
+        {
+            b->right = index_e;
+            a->left = index_d;
+            d->parent = index_a;
+        }
+
+        fix_node(tree, index_a);
+        fix_node(tree, index_b);
+
+        return index_b;
+    }
+
+    return index_a;
+}
+
+void insert_leaf(AABBTree* tree, int leaf)
+{
+    if(tree->root == AABB_TREE_NULL_NODE)
+    {
+        tree->root = leaf;
+        tree->nodes[leaf].parent = AABB_TREE_NULL_NODE;
+        return;
+    }
+
+    //NOTE: Walk down picking the child with the lowest perimeter cost
+    AABB leaf_box = tree->nodes[leaf].box;
+    int index = tree->root;
+    while(!is_leaf(&tree->nodes[index]))
+    {
+        AABBTreeNode* node = &tree->nodes[index];
+        int left = node->left;
+        int right = node->right;
+
+        float area = aabb_perimeter(node->box);
+        float combined_area = aabb_perimeter(aabb_union(node->box, leaf_box));
+
+        //NOTE: Cost of making a new parent for this node and the leaf
+        float cost = 2.0f * combined_area;
+        //NOTE: Minimum cost of pushing the leaf further down
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        float cost_left;
+        AABBTreeNode* left_node = &tree->nodes[left];
+        if(is_leaf(left_node))
+        {
+            cost_left = aabb_perimeter(aabb_union(leaf_box, left_node->box)) + inheritance_cost;
+        }
+        else
+        {
+            float old_area = aabb_perimeter(left_node->box);
+            float new_area = aabb_perimeter(aabb_union(leaf_box, left_node->box));
+            cost_left = (new_area - old_area) + inheritance_cost;
+        }
+
+        float cost_right;
+        AABBTreeNode* right_node = &tree->nodes[right];
+        if(is_leaf(right_node))
+        {
+            cost_right = aabb_perimeter(aabb_union(leaf_box, right_node->box)) + inheritance_cost;
+        }
+        else
+        {
+            float old_area = aabb_perimeter(right_node->box);
+            float new_area = aabb_perimeter(aabb_union(leaf_box, right_node->box));
+            cost_right = (new_area - old_area) + inheritance_cost;
+        }
+
+        if(cost < cost_left && cost < cost_right)
+        {
+            break;
+        }
+
+        index = cost_left < cost_right ? left : right;
+    }
+
+    int sibling = index;
+    int old_parent = tree->nodes[sibling].parent;
+    int new_parent = allocate_node(tree);
+
+    AABBTreeNode* parent = &tree->nodes[new_parent];
+    parent->parent = old_parent;
+    parent->box = aabb_union(leaf_box, tree->nodes[sibling].box);
+    parent->height = tree->nodes[sibling].height + 1;
+    parent->left = sibling;
+    parent->right = leaf;
+
+    if(old_parent != AABB_TREE_NULL_NODE)
+    {
+        if(tree->nodes[old_parent].left == sibling) tree->nodes[old_parent].left = new_parent;
+        else tree->nodes[old_parent].right = new_parent;
+    }
+    else
+    {
+        tree->root = new_parent;
+    }
+
+    tree->nodes[sibling].parent = new_parent;
+    tree->nodes[leaf].parent = new_parent;
+
+    //NOTE: Refit and rebalance the ancestors
+    index = tree->nodes[leaf].parent;
+    while(index != AABB_TREE_NULL_NODE)
+    {
+        index = balance_node(tree, index);
+        fix_node(tree, index);
+        index = tree->nodes[index].parent;
+    }
+}
+
+void remove_leaf(AABBTree* tree, int leaf)
+{
+    if(leaf == tree->root)
+    {
+        tree->root = AABB_TREE_NULL_NODE;
+        return;
+    }
+
+    int parent = tree->nodes[leaf].parent;
+    int grand_parent = tree->nodes[parent].parent;
+    int sibling = tree->nodes[parent].left == leaf ? tree->nodes[parent].right : tree->nodes[parent].left;
+
+    if(grand_parent != AABB_TREE_NULL_NODE)
+    {
+        if(tree->nodes[grand_parent].left == parent) tree->nodes[grand_parent].left = sibling;
+        else tree->nodes[grand_parent].right = sibling;
+        tree->nodes[sibling].parent = grand_parent;
+        free_node(tree, parent);
+
+        int index = grand_parent;
+        while(index != AABB_TREE_NULL_NODE)
+        {
+            index = balance_node(tree, index);
+            fix_node(tree, index);
+            index = tree->nodes[index].parent;
+        }
+    }
+    else
+    {
+        tree->root = sibling;
+        tree->nodes[sibling].parent = AABB_TREE_NULL_NODE;
+        free_node(tree, parent);
+    }
+}
+
+inline AABB fatten_aabb(AABB box)
+{
+    box.min = box.min - V2(AABB_FAT_MARGIN, AABB_FAT_MARGIN);
+    box.max = box.max + V2(AABB_FAT_MARGIN, AABB_FAT_MARGIN);
+    return box;
+}
+
+int create_proxy(AABBTree* tree, AABB box, int body_index)
+{
+    int proxy = allocate_node(tree);
+    tree->nodes[proxy].box = fatten_aabb(box);
+    tree->nodes[proxy].body_index = body_index;
+    tree->nodes[proxy].height = 0;
+
+    insert_leaf(tree, proxy);
+
+    return proxy;
+}
+
+void destroy_proxy(AABBTree* tree, int proxy)
+{
+    remove_leaf(tree, proxy);
+    free_node(tree, proxy);
+}
+
+//NOTE: Returns true if the proxy had to be reinserted. The fat box is extended in the
+//      direction of motion so a moving body keeps its proxy for a few steps
+bool move_proxy(AABBTree* tree, int proxy, AABB box, Vector2 displacement)
+{
+    if(aabb_contains(tree->nodes[proxy].box, box))
+    {
+        return false;
+    }
+
+    remove_leaf(tree, proxy);
+
+    AABB fat = fatten_aabb(box);
+    Vector2 d = displacement * AABB_DISPLACEMENT_MULTIPLIER;
+    if(d.x < 0) fat.min.x += d.x; else fat.max.x += d.x;
+    if(d.y < 0) fat.min.y += d.y; else fat.max.y += d.y;
+
+    tree->nodes[proxy].box = fat;
+    insert_leaf(tree, proxy);
+
+    return true;
+}
+
+//NOTE: Appends every pair (proxy's body, other body) whose fat boxes overlap and where
+//      the other body has a higher index, so querying all proxies yields each pair once
+void query_proxy_pairs(AABBTree* tree, int proxy, std::vector<BroadphasePair>* pairs)
+{
+    if(tree->root == AABB_TREE_NULL_NODE) return;
+
+    AABB box = tree->nodes[proxy].box;
+    int body_index = tree->nodes[proxy].body_index;
+
+    int stack[AABB_TREE_STACK_SIZE];
+    int stack_count = 0;
+    stack[stack_count++] = tree->root;
+
+    while(stack_count > 0)
+    {
+        AABBTreeNode* node = &tree->nodes[stack[--stack_count]];
+        if(!aabb_overlap(node->box, box)) continue;
+
+        if(is_leaf(node))
+        {
+            if(node->body_index > body_index)
+            {
+                pairs->push_back({body_index, node->body_index});
+            }
+        }
+        else
+        {
+            assert(stack_count + 2 <= AABB_TREE_STACK_SIZE);
+            stack[stack_count++] = node->left;
+            stack[stack_count++] = node->right;
+        }
+    }
+}
+
+#endif
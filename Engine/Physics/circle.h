@@ -0,0 +1,121 @@
+#ifndef CIRCLE_H
+#define CIRCLE_H
+
+#include "../shape.h"
+
+/*  NOTE: Circle contacts
+    Circles have no vertices, only center_pos and radius, so they get analytic tests
+    instead of SAT. Both produce a single contact at the deepest point of the circle
+    (or of b for two circles), with the normal pointing from a to b like test_SAT.
+*/
+
+void set_single_contact(RigidBody* body_a, RigidBody* body_b, Manifold* manifold, Vector3 normal, float depth, Vector3 p)
+{
+    manifold->body_a = body_a;
+    manifold->body_b = body_b;
+    manifold->normal = normal;
+    manifold->depth = depth;
+    manifold->mtv = normal * depth;
+    add_contact(manifold, p, depth);
+}
+
+bool test_circle_circle(RigidBody* body_a, RigidBody* body_b, Manifold* manifold)
+{
+    Shape* a = &body_a->shape;
+    Shape* b = &body_b->shape;
+
+    Vector3 d = b->center_pos - a->center_pos;
+    d.z = 0;
+    float r = a->radius + b->radius;
+    float dist_sq = dot(d, d);
+    if(dist_sq > r * r) return false;
+
+    //NOTE: Concentric circles have no preferred direction, push b up
+    float dist = sqrtf(dist_sq);
+    Vector3 n = dist > 0 ? d * (1.0f / dist) : V3(0, 1, 0);
+
+    set_single_contact(body_a, body_b, manifold, n, r - dist, b->center_pos - n * b->radius);
+    return true;
+}
+
+//NOTE: Finds the edge the center is furthest out of, then picks the face or one of its
+//      end points as the closest feature. Normal points out of the polygon
+bool find_circle_polygon_contact(Shape* polygon, Shape* circle, Vector3* normal, float* depth)
+{
+    Vector3 c = circle->center_pos;
+    c.z = 0;
+    float r = circle->radius;
+
+    int edge = 0;
+    float separation = -FLT_MAX;
+    for(int i = 0; i < polygon->vertices_count; ++i)
+    {
+        float s = dot(polygon->global_normals[i], c - polygon->global_vertices[i]);
+        if(s > r) return false;
+        if(s > separation)
+        {
+            separation = s;
+            edge = i;
+        }
+    }
+
+    Vector3 v1 = polygon->global_vertices[edge];
+    Vector3 v2 = polygon->global_vertices[edge + 1 == polygon->vertices_count ? 0 : edge + 1];
+
+    //NOTE: Center inside the polygon, the least deep face wins
+    if(separation <= 0)
+    {
+        *normal = polygon->global_normals[edge];
+        *depth = r - separation;
+        return true;
+    }
+
+    Vector3 closest;
+    if(dot(c - v1, v2 - v1) <= 0)
+    {
+        closest = v1;
+    }
+    else if(dot(c - v2, v1 - v2) <= 0)
+    {
+        closest = v2;
+    }
+    else
+    {
+        *normal = polygon->global_normals[edge];
+        *depth = r - separation;
+        return true;
+    }
+
+    Vector3 d = c - closest;
+    d.z = 0;
+    float dist_sq = dot(d, d);
+    if(dist_sq > r * r) return false;
+
+    float dist = sqrtf(dist_sq);
+    *normal = d * (1.0f / dist);
+    *depth = r - dist;
+    return true;
+}
+
+bool test_polygon_circle(RigidBody* body_a, RigidBody* body_b, Manifold* manifold)
+{
+    Vector3 n;
+    float depth;
+    if(!find_circle_polygon_contact(&body_a->shape, &body_b->shape, &n, &depth)) return false;
+
+    set_single_contact(body_a, body_b, manifold, n, depth, body_b->shape.center_pos - n * body_b->shape.radius);
+    return true;
+}
+
+bool test_circle_polygon(RigidBody* body_a, RigidBody* body_b, Manifold* manifold)
+{
+    Vector3 n;
+    float depth;
+    if(!find_circle_polygon_contact(&body_b->shape, &body_a->shape, &n, &depth)) return false;
+
+    //NOTE: The normal came out of b, the manifold wants it from a to b
+    set_single_contact(body_a, body_b, manifold, -n, depth, body_a->shape.center_pos - n * body_a->shape.radius);
+    return true;
+}
+
+#endif
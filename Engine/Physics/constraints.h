@@ -9,10 +9,11 @@ enum ConstraintType
     DISTANCE
 };
 
+//NOTE: Bodies are indices into the world's BodyStore
 struct DistanceConstraint
 {
-    RigidBody* body_a;
-    RigidBody* body_b;
+    int body_a;
+    int body_b;
 
     float target_length;
 
@@ -26,7 +27,7 @@ struct Constraint
     void* constraint;
 };
 
-DistanceConstraint set_distance_constraint(RigidBody* body_a, RigidBody* body_b, Vector3 global_a, Vector3 global_b)
+DistanceConstraint set_distance_constraint(BodyStore* store, int body_a, int body_b, Vector3 global_a, Vector3 global_b)
 {
     DistanceConstraint c = {};
     c.body_a = body_a;
@@ -35,21 +36,21 @@ DistanceConstraint set_distance_constraint(RigidBody* body_a, RigidBody* body_b,
     Vector3 ab = global_b - global_a;
     c.target_length = length(ab);
 
-    Vector3 r1 = global_a - body_a->position;
-    Vector3 r2 = global_b - body_b->position;
+    Vector3 r1 = global_a - store->position[body_a];
+    Vector3 r2 = global_b - store->position[body_b];
 
-    c.rel_pos_a = transpose(to_mat3(body_a->orientation)) * r1; 
-    c.rel_pos_b = transpose(to_mat3(body_b->orientation)) * r2; 
+    c.rel_pos_a = rotate_to_world(store->orientation[body_a], r1); 
+    c.rel_pos_b = rotate_to_world(store->orientation[body_b], r2); 
 
     return c;
 }
 
-Constraint create_distance_constraint(RigidBody* body_a, RigidBody* body_b, Vector3 global_a, Vector3 global_b)
+Constraint create_distance_constraint(BodyStore* store, int body_a, int body_b, Vector3 global_a, Vector3 global_b)
 {
     Constraint c = {};
     c.type = ConstraintType::DISTANCE;
     c.constraint = malloc(sizeof(DistanceConstraint));
-    *(DistanceConstraint*)c.constraint = set_distance_constraint(body_a, body_b, global_a, global_b);
+    *(DistanceConstraint*)c.constraint = set_distance_constraint(store, body_a, body_b, global_a, global_b);
 
     return c;
 }
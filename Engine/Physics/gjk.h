@@ -6,6 +6,11 @@ struct SimplexPoint
     Vector3 p;
     Vector3 sa;
     Vector3 sb;  
+
+    //NOTE: Vertices sa and sb came from, 0 for a circle. The next support search of the
+    //      same query climbs from them instead of scanning every vertex
+    int index_a;
+    int index_b;
 };
 
 struct Simplex
@@ -14,6 +19,8 @@ struct Simplex
     Vector3 dir;
 };
 
+//NOTE: Polytope edge from point other_index to index, normal and dist are computed once
+//      when the edge is made
 struct Edge
 {
     int index;
@@ -23,34 +30,157 @@ struct Edge
     float dist;
 };
 
-bool gjk_2d(Shape* shape_a, Shape* shape_b, Manifold* manifold);
+//NOTE: https://dyn4j.org/2010/05/epa-expanding-polytope-algorithm/
+//      https://dyn4j.org/2010/04/gjk-distance-closest-points/
+
+#define EPA_MAX_ITERATION 32
+#define EPA_TOLERANCE 0.0001f
+
+//NOTE: Every expansion adds one point and replaces one edge with two, so the simplex
+//      triangle plus one per iteration is all the polytope can ever hold
+#define EPA_MAX_POINTS (EPA_MAX_ITERATION + 3)
+
+/*  NOTE: EPA polytope
+    Points are only ever appended, the edges refer to them by index. The edges live in a
+    binary min heap on dist, so the closest edge is the root and splitting it is a pop and
+    two pushes, O(log n) per expansion with nothing allocated. GJK can end on a triangle
+    of either winding, splitting an edge keeps it, so the outward side is picked once.
+*/
+struct Polytope
+{
+    SimplexPoint points[EPA_MAX_POINTS];
+    int point_count;
+    bool counter_clockwise;
+
+    Edge edges[EPA_MAX_POINTS];
+    int edge_count;
+};
+
+bool gjk_2d(Shape* shape_a, Shape* shape_b, Manifold* manifold, GjkCache* cache = 0);
+
+void push_polytope_edge(Polytope* polytope, int other_index, int index);
+Edge pop_closest_edge(Polytope* polytope);
+bool epa_2d(Simplex* s, Shape* shape_a, Shape* shape_b, Manifold* manifold);
+
+//NOTE: hint is the vertex to climb from, -1 scans all of them
+Vector3 get_support_vertex(Shape* shape, Vector3 dir, int hint, int* index)
+{
+    if(shape->type == ShapeType::CIRCLE)
+    {
+        *index = 0;
+        return get_furthest_point_in_direction(shape, dir);
+    }
+
+    *index = climb_to_furthest_point_index(shape, dir, hint);
+    return shape->global_vertices[*index];
+}
+
+SimplexPoint support_point(Shape* shape_a, Shape* shape_b, Vector3 dir, int hint_a = -1, int hint_b = -1)
+{
+    SimplexPoint point = {};
+    point.sa = get_support_vertex(shape_a, dir, hint_a, &point.index_a);
+    point.sb = get_support_vertex(shape_b, -dir, hint_b, &point.index_b);
+    point.p = point.sa - point.sb;
 
-Edge find_closest_edge(std::vector<SimplexPoint>* simplex);
-void epa_2d(Simplex* s, Shape* shape_a, Shape* shape_b, Manifold* manifold);
+    return point;
+}
 
-SimplexPoint support_point(Shape* shape_a, Shape* shape_b, Vector3 dir)
+SimplexPoint make_simplex_point(Shape* shape_a, Shape* shape_b, int index_a, int index_b)
 {
     SimplexPoint point = {};
-    point.sa = get_furthest_point_in_direction(shape_a, dir);
-    point.sb = get_furthest_point_in_direction(shape_b, -dir);
+    point.index_a = index_a;
+    point.index_b = index_b;
+    point.sa = shape_a->global_vertices[index_a];
+    point.sb = shape_b->global_vertices[index_b];
     point.p = point.sa - point.sb;
 
     return point;
 }
 
+inline float cross_2d(Vector3 a, Vector3 b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+//NOTE: Either winding, the origin is inside when it is on the same side of all three edges.
+//      A flat triangle gives EPA no direction to expand in, so it never holds the origin
+bool triangle_contains_origin(Vector3 a, Vector3 b, Vector3 c)
+{
+    if(cross_2d(b - a, c - b) == 0) return false;
+
+    float d1 = cross_2d(b - a, -a);
+    float d2 = cross_2d(c - b, -b);
+    float d3 = cross_2d(a - c, -c);
+
+    bool negative = d1 < 0 || d2 < 0 || d3 < 0;
+    bool positive = d1 > 0 || d2 > 0 || d3 > 0;
+    return !(negative && positive);
+}
+
+void save_gjk_cache(GjkCache* cache, SimplexPoint* points, int count)
+{
+    if(!cache) return;
+
+    cache->count = count;
+    for(int i = 0; i < count; ++i)
+    {
+        cache->index_a[i] = points[i].index_a;
+        cache->index_b[i] = points[i].index_b;
+    }
+}
+
 //NOTE: Reference https://dyn4j.org/2010/04/gjk-gilbert-johnson-keerthi/
-bool gjk_2d(Shape* shape_a, Shape* shape_b, Manifold* manifold)
+bool gjk_2d(Shape* shape_a, Shape* shape_b, Manifold* manifold, GjkCache* cache)
 {
     Simplex s;
-    s.dir = shape_b->center_pos - shape_a->center_pos;
-    s.c = support_point(shape_a, shape_b, s.dir);
-    s.dir = -s.c.p;
+    bool seeded = false;
 
-    s.b = support_point(shape_a, shape_b, s.dir);
-    if(dot(s.b.p, s.dir) < 0)
+    bool cacheable = shape_a->type != ShapeType::CIRCLE && shape_b->type != ShapeType::CIRCLE;
+    if(cache && cacheable && cache->count >= 2)
     {
-        *manifold = {};
-        return false;
+        SimplexPoint points[3];
+        for(int i = 0; i < cache->count; ++i)
+        {
+            points[i] = make_simplex_point(shape_a, shape_b, cache->index_a[i], cache->index_b[i]);
+        }
+
+        if(cache->count == 3 && triangle_contains_origin(points[0].p, points[1].p, points[2].p))
+        {
+            s.c = points[0];
+            s.b = points[1];
+            s.a = points[2];
+
+            //NOTE: The cached vertices are only known to be in the Minkowski difference, not on
+            //      its hull. EPA expands from them all the same, the rare triangle it can't
+            //      expand from is found again from scratch
+            manifold->collided = true;
+            if(epa_2d(&s, shape_a, shape_b, manifold)) return true;
+
+            cache->count = 0;
+            return gjk_2d(shape_a, shape_b, manifold, cache);
+        }
+        else
+        {
+            s.c = points[cache->count - 2];
+            s.b = points[cache->count - 1];
+            seeded = !(s.c.p == s.b.p);
+        }
+    }
+
+    if(!seeded)
+    {
+        s.dir = shape_b->center_pos - shape_a->center_pos;
+        s.c = support_point(shape_a, shape_b, s.dir);
+        s.dir = -s.c.p;
+
+        s.b = support_point(shape_a, shape_b, s.dir, s.c.index_a, s.c.index_b);
+        if(dot(s.b.p, s.dir) < 0)
+        {
+            *manifold = {};
+            SimplexPoint segment[2] = {s.c, s.b};
+            save_gjk_cache(cache, segment, cacheable ? 2 : 0);
+            return false;
+        }
     }
 
     Vector3 bc = s.c.p - s.b.p;
@@ -68,11 +198,13 @@ bool gjk_2d(Shape* shape_a, Shape* shape_b, Manifold* manifold)
     int max_iteration = 0;
     while(max_iteration < 50)
     {
-        s.a = support_point(shape_a, shape_b, s.dir);
+        s.a = support_point(shape_a, shape_b, s.dir, s.b.index_a, s.b.index_b);
         if(dot(s.a.p, s.dir) < 0)
         {
             manifold->collided = false;
             manifold->mtv = {};
+            SimplexPoint segment[2] = {s.c, s.b};
+            save_gjk_cache(cache, segment, cacheable ? 2 : 0);
             return false;
         }
 
@@ -93,9 +225,13 @@ bool gjk_2d(Shape* shape_a, Shape* shape_b, Manifold* manifold)
             if(dot(ab_perp, ao) < 0)
             {
                 manifold->collided = true;
-                //epa
-                epa_2d(&s, shape_a, shape_b, manifold);
-                return true;
+                SimplexPoint triangle[3] = {s.c, s.b, s.a};
+                save_gjk_cache(cache, triangle, cacheable ? 3 : 0);
+                if(epa_2d(&s, shape_a, shape_b, manifold) || !seeded) return true;
+
+                //NOTE: Same for a triangle grown from a cached segment
+                cache->count = 0;
+                return gjk_2d(shape_a, shape_b, manifold, cache);
             }
 
             s.c = s.b;
@@ -109,62 +245,84 @@ bool gjk_2d(Shape* shape_a, Shape* shape_b, Manifold* manifold)
 
     //NOTE: if iteration is above 50 then we assume there's something went wrong and there's no collision
     *manifold = {};
+    save_gjk_cache(cache, 0, 0);
     return false;
 }
 
-Edge find_closest_edge(std::vector<SimplexPoint>* simplex)
+void push_polytope_edge(Polytope* polytope, int other_index, int index)
 {
-    Edge edge = {};
+    Vector3 a = polytope->points[other_index].p;
+    Vector3 b = polytope->points[index].p;
 
-    edge.dist = FLT_MAX;
+    Vector3 e = b - a;
+    Vector3 e_perp = V3(polytope->counter_clockwise ? reverse_perp(e.xy) : perp(e.xy), 0);
+    Vector3 n = normalize(e_perp);
 
-    for(int i = 0; i < simplex->size(); ++i)
-    {
-        int j = i + 1 == simplex->size() ? 0 : i+1;
+    assert(!(n == V3()));
+    assert(polytope->edge_count < EPA_MAX_POINTS);
+
+    Edge edge = {};
+    edge.index = index;
+    edge.other_index = other_index;
+    edge.normal = n;
+    edge.dist = dot(n, a);
 
-        Vector3 a = simplex->at(i).p;
-        Vector3 b = simplex->at(j).p;
+    int i = polytope->edge_count++;
+    while(i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if(!(edge.dist < polytope->edges[parent].dist)) break;
 
-        Vector3 e = b - a;
-        Vector3 oa = a;
+        polytope->edges[i] = polytope->edges[parent];
+        i = parent;
+    }
+    polytope->edges[i] = edge;
+}
 
-        Vector3 e_perp = V3(perp(e.xy), 0);
-        Vector3 n = normalize(e_perp);
+Edge pop_closest_edge(Polytope* polytope)
+{
+    Edge* edges = polytope->edges;
+    Edge closest = edges[0];
+    Edge last = edges[--polytope->edge_count];
+    int count = polytope->edge_count;
 
-        assert(!(n == V3()));
+    int i = 0;
+    while(true)
+    {
+        int child = i * 2 + 1;
+        if(child >= count) break;
+        if(child + 1 < count && edges[child + 1].dist < edges[child].dist) ++child;
+        if(!(edges[child].dist < last.dist)) break;
 
-        float dist = dot(n, a);
-        if(dist < edge.dist)
-        {
-            edge.dist = dist;
-            edge.index = j;
-            edge.other_index = i;
-            edge.normal = n;
-        }
+        edges[i] = edges[child];
+        i = child;
     }
+    if(count > 0) edges[i] = last;
 
-    return edge;
+    return closest;
 }
 
-//NOTE: https://dyn4j.org/2010/05/epa-expanding-polytope-algorithm/
-//      https://dyn4j.org/2010/04/gjk-distance-closest-points/
-
-#define EPA_MAX_ITERATION 32
-#define EPA_TOLERANCE 0.0001f
-
-void epa_2d(Simplex* s, Shape* shape_a, Shape* shape_b, Manifold* manifold)
+bool epa_2d(Simplex* s, Shape* shape_a, Shape* shape_b, Manifold* manifold)
 {
-    std::vector<SimplexPoint> simplex;
-    simplex.push_back(s->c);
-    simplex.push_back(s->b);
-    simplex.push_back(s->a);
+    Polytope polytope;
+    polytope.points[0] = s->c;
+    polytope.points[1] = s->b;
+    polytope.points[2] = s->a;
+    polytope.point_count = 3;
+    polytope.counter_clockwise = cross_2d(s->b.p - s->c.p, s->a.p - s->b.p) > 0;
+    polytope.edge_count = 0;
+    push_polytope_edge(&polytope, 0, 1);
+    push_polytope_edge(&polytope, 1, 2);
+    push_polytope_edge(&polytope, 2, 0);
+
+    SimplexPoint* simplex = polytope.points;
 
     int max_iteration = 0;
 
     while(max_iteration < EPA_MAX_ITERATION)
     {
-        Edge edge = find_closest_edge(&simplex);
-        SimplexPoint new_point = support_point(shape_a, shape_b, edge.normal);
+        Edge edge = pop_closest_edge(&polytope);
+        SimplexPoint new_point = support_point(shape_a, shape_b, edge.normal, simplex[edge.index].index_a, simplex[edge.index].index_b);
         float dot_product = dot(new_point.p, edge.normal);
 
         if(dot_product - edge.dist < EPA_TOLERANCE)
@@ -206,15 +364,41 @@ void epa_2d(Simplex* s, Shape* shape_a, Shape* shape_b, Manifold* manifold)
 
             manifold->mtv = manifold->normal * manifold->depth;
 
-            break;
+            return true;
         }
         else
         {
-            simplex.insert(simplex.begin() + edge.index, new_point);
+            int index = polytope.point_count++;
+            polytope.points[index] = new_point;
+            push_polytope_edge(&polytope, edge.other_index, index);
+            push_polytope_edge(&polytope, index, edge.index);
         }
 
         max_iteration++;
     }
+
+    return false;
 } 
 
-#endif
\ No newline at end of file
+/*  NOTE: GJK kernel
+    GJK and EPA give the normal and depth, the contacts are clipped the way test_SAT clips
+    them. Manifold::gjk_cache goes in as the pair's simplex from last frame and comes out
+    as this one's, so a pair that keeps touching goes from its cached triangle straight to
+    EPA. Support searches climb the outline, they don't grow with the vertex count the
+    way SAT's every axis against every vertex does.
+*/
+bool test_gjk(RigidBody* body_a, RigidBody* body_b, Manifold* manifold)
+{
+    GjkCache cache = manifold->gjk_cache;
+    bool hit = gjk_2d(&body_a->shape, &body_b->shape, manifold, &cache);
+    manifold->gjk_cache = cache;
+    if(!hit) return false;
+
+    //NOTE: EPA's normal points from b to a, the manifold's from a to b
+    float depth = manifold->depth;
+    Vector3 normal = -manifold->normal;
+    set_sat_manifold(body_a, body_b, manifold, normal, depth);
+    return true;
+}
+
+#endif
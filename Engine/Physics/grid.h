@@ -0,0 +1,171 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <vector>
+#include "broadphase.h"
+
+/*  NOTE: Uniform grid / spatial hash
+    Meant for swarms of bodies that are all about the same size (the mouse spawned
+    boxes). Every box is inserted into each cell it touches, cells are hashed into a
+    table and the entries are laid out bucket by bucket with a counting sort, so the
+    whole grid is two flat arrays that get reused every frame.
+    A pair that shares several cells is only reported from the cell holding the min
+    corner of the two boxes' overlap, so no duplicate removal pass is needed.
+*/
+
+#define GRID_DEFAULT_CELL_SIZE 64.0f
+#define GRID_MIN_TABLE_SIZE 64
+
+struct GridEntry
+{
+    int box;
+    int cell_x;
+    int cell_y;
+};
+
+struct UniformGrid
+{
+    float cell_size;
+    u32 table_mask;
+
+    std::vector<AABB> boxes;
+
+    //NOTE: Entries of bucket b are entries[cell_start[b]] .. entries[cell_start[b + 1] - 1]
+    std::vector<int> cell_start;
+    std::vector<GridEntry> entries;
+    std::vector<GridEntry> unsorted;
+    std::vector<u32> entry_bucket;
+};
+
+inline int grid_coord(float v, float inverse_cell_size)
+{
+    return (int)floorf(v * inverse_cell_size);
+}
+
+inline u32 grid_hash(int x, int y, u32 mask)
+{
+    return (((u32)x * 73856093u) ^ ((u32)y * 19349663u)) & mask;
+}
+
+void init_grid(UniformGrid* grid, float cell_size = GRID_DEFAULT_CELL_SIZE)
+{
+    grid->cell_size = cell_size;
+    grid->table_mask = 0;
+    grid->boxes.clear();
+    grid->cell_start.clear();
+    grid->entries.clear();
+    grid->unsorted.clear();
+    grid->entry_bucket.clear();
+}
+
+int grid_add_box(UniformGrid* grid, AABB box)
+{
+    grid->boxes.push_back(box);
+    return (int)grid->boxes.size() - 1;
+}
+
+//NOTE: Boxes must already hold this frame's bounds
+void grid_build(UniformGrid* grid)
+{
+    float inverse_cell_size = 1.0f / grid->cell_size;
+
+    grid->unsorted.clear();
+    for(int i = 0; i < (int)grid->boxes.size(); ++i)
+    {
+        AABB box = grid->boxes[i];
+        int x0 = grid_coord(box.min.x, inverse_cell_size);
+        int y0 = grid_coord(box.min.y, inverse_cell_size);
+        int x1 = grid_coord(box.max.x, inverse_cell_size);
+        int y1 = grid_coord(box.max.y, inverse_cell_size);
+
+        for(int y = y0; y <= y1; ++y)
+        {
+            for(int x = x0; x <= x1; ++x)
+            {
+                grid->unsorted.push_back({i, x, y});
+            }
+        }
+    }
+
+    int entry_count = (int)grid->unsorted.size();
+
+    //NOTE: Keep the table at least twice the entry count to make collisions rare
+    u32 table_size = GRID_MIN_TABLE_SIZE;
+    while(table_size < (u32)entry_count * 2) table_size <<= 1;
+    grid->table_mask = table_size - 1;
+
+    //NOTE: Counting sort by bucket
+    grid->cell_start.assign(table_size + 1, 0);
+    grid->entry_bucket.resize(entry_count);
+    grid->entries.resize(entry_count);
+
+    for(int i = 0; i < entry_count; ++i)
+    {
+        GridEntry e = grid->unsorted[i];
+        u32 bucket = grid_hash(e.cell_x, e.cell_y, grid->table_mask);
+        grid->entry_bucket[i] = bucket;
+        ++grid->cell_start[bucket];
+    }
+
+    int sum = 0;
+    for(u32 b = 0; b <= table_size; ++b)
+    {
+        sum += grid->cell_start[b];
+        grid->cell_start[b] = sum;
+    }
+
+    //NOTE: Walking backwards leaves cell_start pointing at the first entry of each bucket
+    //      and keeps entries in box order inside a bucket
+    for(int i = entry_count - 1; i >= 0; --i)
+    {
+        int index = --grid->cell_start[grid->entry_bucket[i]];
+        grid->entries[index] = grid->unsorted[i];
+    }
+}
+
+//NOTE: Appends the pairs found in buckets [first, last), unsorted
+void grid_find_pairs_in_buckets(UniformGrid* grid, u32 first, u32 last, std::vector<BroadphasePair>* pairs)
+{
+    float inverse_cell_size = 1.0f / grid->cell_size;
+    GridEntry* entries = grid->entries.data();
+    AABB* boxes = grid->boxes.data();
+
+    for(u32 b = first; b < last; ++b)
+    {
+        int start = grid->cell_start[b];
+        int end = grid->cell_start[b + 1];
+
+        for(int i = start; i < end; ++i)
+        {
+            GridEntry ea = entries[i];
+            AABB box_a = boxes[ea.box];
+
+            for(int j = i + 1; j < end; ++j)
+            {
+                GridEntry eb = entries[j];
+
+                //NOTE: Different cells hashed to the same bucket
+                if(ea.cell_x != eb.cell_x || ea.cell_y != eb.cell_y) continue;
+
+                AABB box_b = boxes[eb.box];
+                if(!aabb_overlap(box_a, box_b)) continue;
+
+                int owner_x = grid_coord(max(box_a.min.x, box_b.min.x), inverse_cell_size);
+                int owner_y = grid_coord(max(box_a.min.y, box_b.min.y), inverse_cell_size);
+                if(owner_x != ea.cell_x || owner_y != ea.cell_y) continue;
+
+                if(ea.box < eb.box) pairs->push_back({ea.box, eb.box});
+                else pairs->push_back({eb.box, ea.box});
+            }
+        }
+    }
+}
+
+void grid_find_pairs(UniformGrid* grid, std::vector<BroadphasePair>* pairs)
+{
+    pairs->clear();
+    grid_find_pairs_in_buckets(grid, 0, grid->table_mask + 1, pairs);
+    sort_pairs(pairs);
+}
+
+#endif
@@ -4,18 +4,84 @@
 #include <vector>
 #include "math.h"
 
+#define CONTACT_BAUMGARTE 0.5f
+#define CONTACT_POSITION_BAUMGARTE 0.2f
+//NOTE: Leaving a bit of penetration unresolved keeps the contact alive between frames,
+//      without it the warm started impulse keeps popping resting boxes apart
+#define CONTACT_PENETRATION_SLOP 0.5f
+#define CONTACT_MAX_CORRECTION 5.0f
+//NOTE: Largest condition number of K a two contact block is solved with
+#define CONTACT_BLOCK_MAX_CONDITION 1000.0f
+//NOTE: Fastest a soft contact pushes penetrating bodies apart
+#define CONTACT_MAX_BIAS_VELOCITY 100.0f
+//NOTE: How far a manifold may drift before refresh_manifold gives it back to the narrowphase:
+//      sliding of the anchors along the normal's plane, the cosine between the normal and
+//      the normal as each body carries it, and steps in a row without a narrowphase test
+#define CONTACT_REFRESH_MAX_DRIFT 0.25f
+#define CONTACT_REFRESH_MIN_COS 0.999f
+#define CONTACT_MAX_REFRESHES 4
+
+//NOTE: Clipping an incident edge against a reference edge leaves at most two points
+#define MAX_MANIFOLD_CONTACTS 2
+
 struct Contact
 {
+    //NOTE: Velocity bias, restitution and (without position iterations) baumgarte.
+    //      In the soft step the separation bias of the current substep
     float b;
+    float restitution_bias;
+
+    //NOTE: Soft step only, 1 and 0 leave the normal row rigid. See update_soft_contact
+    float mass_scale;
+    float impulse_scale;
 
     Vector3 normal;
     float depth;
 
+    //NOTE: World position when the contact was generated
+    Vector3 position;
+
     Vector3 rel_pos_a;
     Vector3 rel_pos_b;
 
+    //NOTE: Contact point in each body's unrotated local frame, used to track the
+    //      penetration while positions are corrected
+    Vector3 local_anchor_a;
+    Vector3 local_anchor_b;
+
+    Vector3 tangent;
+    float normal_mass;
+    float tangent_mass;
+
+    //NOTE: Accumulated impulses, carried over to the next frame when the contact is matched
+    //      again by feature_id and applied up front as a warm start
     float sum_impulse_contact;
     Vector3 sum_impulse_friction;
+
+    u32 feature_id;
+};
+
+/*  NOTE: GJK cache
+    The simplex gjk_2d ended with, as vertex indices on both shapes. find_collisions keeps
+    one per pair in Manifold::gjk_cache and passes it back in next time: the simplex is
+    rebuilt from the moved shapes, a triangle that still holds the origin goes straight to
+    EPA and anything else seeds the search with its last two points instead of the center
+    direction. The support search climbs from the indices of the previous point instead of
+    scanning every vertex. Circles have no vertices to remember, pairs with one always
+    start from scratch.
+*/
+struct GjkCache
+{
+    int count;
+    int index_a[3];
+    int index_b[3];
+};
+
+//NOTE: Key and last simplex of a pair, kept in key order from one step to the next
+struct GjkCacheRef
+{
+    u64 key;
+    GjkCache cache;
 };
 
 struct Manifold 
@@ -32,146 +98,488 @@ struct Manifold
     int index_a;
     int index_b;
 
-    std::vector<Vector3> cp;
-    std::vector<Contact> contacts;
+    //NOTE: Mixed material of the two bodies, filled by find_collisions
+    float friction;
+    float restitution;
+
+    //NOTE: SAT axis to try first going in, the one that decided coming out, see test_SAT.
+    //      sat_axes_tested counts the axis projections, find_collisions sums it per step
+    int sat_axis;
+    int sat_axes_tested;
+
+    //NOTE: Last simplex of the pair going in, this one's coming out, see test_gjk
+    GjkCache gjk_cache;
+
+    //NOTE: Normal in each body's unrotated local frame, filled in with the anchors.
+    //      refresh_count is the steps since the narrowphase last made the manifold
+    Vector3 local_normal_a;
+    Vector3 local_normal_b;
+    int refresh_count;
+
+    //NOTE: Two contact normal block, filled by prepare_contact_block. K is symmetric and
+    //      stored as k11, k12, k22, block_mass is its inverse in the same order
+    bool block_solve;
+    float block_k[3];
+    float block_mass[3];
+
+    //NOTE: Fixed size so a manifold is plain data, the narrowphase writes straight into
+    //      the world's manifold array and never touches the heap
+    u64 key;
+    int contact_count;
+    Vector3 cp[MAX_MANIFOLD_CONTACTS];
+    Contact contacts[MAX_MANIFOLD_CONTACTS];
+};
+
+//NOTE: Key and slot of a manifold, kept in key order next to the manifold array so
+//      looking up last frame's manifold doesn't walk the manifolds themselves
+struct ManifoldRef
+{
+    u64 key;
+    int index;
 };
 
-void add_contact(Manifold* manifold, Vector3 p)
+//NOTE: depth is the point's own penetration, a tilted box's shallow corner isn't as deep
+//      as the manifold's
+void add_contact(Manifold* manifold, Vector3 p, float depth, u32 feature_id = 0)
 {
-    Vector3 r1 = p - manifold->body_a->position;
-    Vector3 r2 = p - manifold->body_b->position;
+    if(manifold->contact_count == MAX_MANIFOLD_CONTACTS) return;
 
-    Contact contact;
-    contact.rel_pos_a = r1;
-    contact.rel_pos_b = r2;
+    Contact contact = {};
+    contact.position = p;
     contact.normal = manifold->normal;
-    contact.depth = manifold->depth;
-    
-    manifold->contacts.push_back(contact);
+    contact.depth = depth;
+    contact.feature_id = feature_id;
+
+    manifold->cp[manifold->contact_count] = p;
+    manifold->contacts[manifold->contact_count++] = contact;
 }
 
-void update_contact(Manifold* m, Contact* c)
+//NOTE: Narrowphase only sees shapes, the offsets from the body centers are filled in
+//      once the manifold knows its body indices
+void set_contact_anchors(BodyStore* store, Manifold* m)
 {
-    c->sum_impulse_contact = 0;
-    c->sum_impulse_friction = V3();
-    c->b = 0;
+    for(int i = 0; i < m->contact_count; ++i)
+    {
+        Contact& c = m->contacts[i];
+        c.rel_pos_a = c.position - store->position[m->index_a];
+        c.rel_pos_b = c.position - store->position[m->index_b];
+        c.local_anchor_a = rotate_to_local(store->orientation[m->index_a], c.rel_pos_a);
+        c.local_anchor_b = rotate_to_local(store->orientation[m->index_b], c.rel_pos_b);
+    }
 
-    float baumgarte_scalar = 0.1f;
-    float baumgarte_slop = 0.001f;
-    float penetration_slop = min(c->depth + baumgarte_slop, 0);
+    m->local_normal_a = rotate_to_local(store->orientation[m->index_a], m->normal);
+    m->local_normal_b = rotate_to_local(store->orientation[m->index_b], m->normal);
+}
 
-    c->b += -(baumgarte_scalar / physics_dt) * penetration_slop;
+/*  NOTE: Contact refresh
+    A pair that hardly moved since the narrowphase made its manifold gets the same contact
+    points again. Instead of clipping, each contact follows its anchors: the two bodies
+    carry their anchor to a new world point, the contact stays where body a carried it
+    and its depth drops by how far they moved apart along the normal. The manifold is
+    anchored again at the new points and keeps its accumulated impulses as they are.
+    Moving the contact to the middle of the two points instead shifts both anchors every
+    step, stacks in the soft step shear from it.
+    Returns false, leaving the manifold to the narrowphase, once the bodies turned or slid
+    too far against each other, a contact separated or it was refreshed too often in a row.
+*/
+bool refresh_manifold(BodyStore* store, Manifold* m)
+{
+    if(m->refresh_count >= CONTACT_MAX_REFRESHES) return false;
+
+    int a = m->index_a;
+    int b = m->index_b;
+
+    //NOTE: The narrowphase normal is a face normal of one of the two bodies. Averaging
+    //      what each body makes of it tilts it by half their relative turn, in a stack
+    //      that pushes every box sideways. It stays as it is while neither body turned it
+    Vector3 normal = m->normal;
+    Vector3 normal_a = rotate_to_world(store->orientation[a], m->local_normal_a);
+    Vector3 normal_b = rotate_to_world(store->orientation[b], m->local_normal_b);
+    if(dot(normal_a, normal) < CONTACT_REFRESH_MIN_COS || dot(normal_b, normal) < CONTACT_REFRESH_MIN_COS) return false;
+
+    Vector3 points[MAX_MANIFOLD_CONTACTS];
+    float depths[MAX_MANIFOLD_CONTACTS];
+    for(int i = 0; i < m->contact_count; ++i)
+    {
+        Contact* c = &m->contacts[i];
+        Vector3 point_a = store->position[a] + rotate_to_world(store->orientation[a], c->local_anchor_a);
+        Vector3 point_b = store->position[b] + rotate_to_world(store->orientation[b], c->local_anchor_b);
+
+        Vector3 moved = point_b - point_a;
+        float along_normal = dot(moved, normal);
+        Vector3 slide = moved - normal * along_normal;
+        depths[i] = c->depth - along_normal;
+        if(depths[i] < 0 || dot(slide, slide) > CONTACT_REFRESH_MAX_DRIFT * CONTACT_REFRESH_MAX_DRIFT) return false;
 
-    float elasticity = m->body_a->restitution * m->body_b->restitution;
-    float elasticity_term = dot(c->normal, m->body_a->velocity + 
-                            cross(c->rel_pos_a, m->body_a->angular_velocity) - 
-                            m->body_b->velocity -
-                            cross(c->rel_pos_b, m->body_b->angular_velocity));
+        points[i] = point_a;
+    }
 
-    
-    c->b += (elasticity * elasticity_term) / m->contacts.size();
+    m->normal = normal;
+    m->depth = 0;
+    for(int i = 0; i < m->contact_count; ++i)
+    {
+        Contact* c = &m->contacts[i];
+        c->position = points[i];
+        c->normal = normal;
+        c->depth = depths[i];
+        m->cp[i] = points[i];
+        m->depth = max(m->depth, depths[i]);
+    }
+
+    set_contact_anchors(store, m);
+    ++m->refresh_count;
+    return true;
 }
 
-void solve_contact_constraint(Manifold* m, Contact* c)
+//NOTE: Copies the accumulated impulses of contacts that existed last frame
+void match_contacts(Manifold* m, Manifold* old_m)
 {
-    Vector3 r1 = c->rel_pos_a;
-    Vector3 r2 = c->rel_pos_b;
+    for(int i = 0; i < m->contact_count; ++i)
+    {
+        Contact& c = m->contacts[i];
+        for(int j = 0; j < old_m->contact_count; ++j)
+        {
+            Contact& old_c = old_m->contacts[j];
+            if(old_c.feature_id == c.feature_id)
+            {
+                c.sum_impulse_contact = old_c.sum_impulse_contact;
+                c.sum_impulse_friction = old_c.sum_impulse_friction;
+                break;
+            }
+        }
+    }
+}
+
+/*  NOTE: Sign convention
+    A positive angle turns a shape clockwise (see rotation.h), the opposite of the usual
+    right hand rule. The velocity of a point r away from the center is therefore v + r x w,
+    and an impulse P at r changes w by -Iinv * (r x P). All contact rows below use that
+    convention, cross_angular keeps them the same for the 2D and 3D body types.
+*/
+
+inline Vector3 get_point_velocity(BodyStore* store, int body, Vector3 r)
+{
+    return store->velocity[body] + cross(r, store->angular_velocity[body]);
+}
+
+//NOTE: Impulse p is applied to b and -p to a
+void apply_contact_impulse(BodyStore* store, Manifold* m, Contact* c, Vector3 p)
+{
+    int a = m->index_a;
+    int b = m->index_b;
+
+    if(store->inverse_mass[a] != 0)
+    {
+        store->velocity[a] -= p * store->inverse_mass[a];
+        if(can_rotate(store, a))
+            store->angular_velocity[a] += store->inverse_inertia[a] * cross_angular(c->rel_pos_a, p);
+    }
+    if(store->inverse_mass[b] != 0)
+    {
+        store->velocity[b] += p * store->inverse_mass[b];
+        if(can_rotate(store, b))
+            store->angular_velocity[b] -= store->inverse_inertia[b] * cross_angular(c->rel_pos_b, p);
+    }
+}
+
+//NOTE: 1 / (J * Minv * Jt) for a row along direction d
+float get_effective_mass(BodyStore* store, Manifold* m, Vector3 r1, Vector3 r2, Vector3 d)
+{
+    int a = m->index_a;
+    int b = m->index_b;
+
+    float k = store->inverse_mass[a] + store->inverse_mass[b];
+    if(can_rotate(store, a))
+    {
+        Angular j2 = cross_angular(r1, d);
+        k += dot_angular(j2, store->inverse_inertia[a] * j2);
+    }
+    if(can_rotate(store, b))
+    {
+        Angular j4 = cross_angular(r2, d);
+        k += dot_angular(j4, store->inverse_inertia[b] * j4);
+    }
+
+    return k > 0 ? 1.0f / k : 0;
+}
+
+void warm_start_contact(BodyStore* store, Manifold* m, Contact* c)
+{
+    apply_contact_impulse(store, m, c, c->normal * c->sum_impulse_contact + c->sum_impulse_friction);
+}
+
+inline Vector3 get_relative_velocity(BodyStore* store, Manifold* m, Contact* c)
+{
+    return get_point_velocity(store, m->index_b, c->rel_pos_b) - get_point_velocity(store, m->index_a, c->rel_pos_a);
+}
+
+//NOTE: Runs once per step before the iterations, everything here stays constant while iterating
+void prepare_contact(BodyStore* store, Manifold* m, Contact* c, float dt, bool use_baumgarte)
+{
+    c->tangent = V3(reverse_perp(c->normal.xy));
+    c->normal_mass = get_effective_mass(store, m, c->rel_pos_a, c->rel_pos_b, c->normal);
+    c->tangent_mass = get_effective_mass(store, m, c->rel_pos_a, c->rel_pos_b, c->tangent);
+
+    //NOTE: Tangent may flip between frames, keep only the part of last frame's friction along it
+    c->sum_impulse_friction = c->tangent * dot(c->sum_impulse_friction, c->tangent);
+
+    float closing_vel = dot(get_relative_velocity(store, m, c), c->normal);
+    c->restitution_bias = m->restitution * closing_vel;
+    c->b = c->restitution_bias;
+    c->mass_scale = 1;
+    c->impulse_scale = 0;
+
+    if(use_baumgarte)
+    {
+        c->b -= (CONTACT_BAUMGARTE / dt) * max(c->depth - CONTACT_PENETRATION_SLOP, 0);
+    }
+}
 
-    //Resolution
-#if 1
 /*  NOTE: 
     JV + b = 0
     C: (Pb - Pa) . n >= 0
-    C': (-va - wa x ra + vb + wb x rb) . n >= 0
-    where J = [-n r1xn n -r2xn]
+    C': (-va - ra x wa + vb + rb x wb) . n >= 0
     lambda = -(JV + b) * EffectiveMass
-    EffectiveMass = (J*Minv*JT)
+    EffectiveMass = 1 / (J*Minv*JT)
+
+    Accumulated impulses are clamped instead of the increments: normal >= 0 and
+    |friction| <= mu * normal. Friction goes first so the normal row has the last word
+    on penetration.
 */
+void solve_contact_friction(BodyStore* store, Manifold* m, Contact* c)
+{
+    if(c->tangent_mass > 0)
+    {
+        float lambda = -dot(get_relative_velocity(store, m, c), c->tangent) * c->tangent_mass;
+        float max_friction = m->friction * c->sum_impulse_contact;
 
-    Vector3 j1 = m->body_a->inverse_mass == 0 ? V3() : -c->normal;
-    Vector3 j2 = m->body_a->inverse_mass == 0 ? V3() : cross(r1, c->normal);
-    Vector3 j3 = m->body_b->inverse_mass == 0 ? V3() : c->normal;
-    Vector3 j4 = m->body_b->inverse_mass == 0 ? V3() : -cross(r2, c->normal);
-    
-    float k = m->body_a->inverse_mass + dot(j2, m->body_a->inverse_inertia * j2) +
-              m->body_b->inverse_mass + dot(j4, m->body_b->inverse_inertia * j4);
+        float old_sum = dot(c->sum_impulse_friction, c->tangent);
+        float new_sum = clamp(old_sum + lambda, -max_friction, max_friction);
+        c->sum_impulse_friction = c->tangent * new_sum;
 
-    if(k != 0)
+        apply_contact_impulse(store, m, c, c->tangent * (new_sum - old_sum));
+    }
+}
+
+void solve_contact_normal(BodyStore* store, Manifold* m, Contact* c)
+{
+    if(c->normal_mass > 0)
     {
-        float effective_mass = 1.0f / k;
+        float old_sum = c->sum_impulse_contact;
+        float lambda = -(dot(get_relative_velocity(store, m, c), c->normal) + c->b) * c->normal_mass * c->mass_scale - c->impulse_scale * old_sum;
+        c->sum_impulse_contact = max(old_sum + lambda, 0);
 
-        float jv = dot(j1, m->body_a->velocity) +
-                   dot(j2, m->body_a->angular_velocity) +
-                   dot(j3, m->body_b->velocity) +
-                   dot(j4, m->body_b->angular_velocity);
+        apply_contact_impulse(store, m, c, c->normal * (c->sum_impulse_contact - old_sum));
+    }
+}
 
-        float beta = 0.5f;
-        float restitution = m->body_a->restitution * m->body_b->restitution;
-        Vector3 rel_vel = -m->body_a->velocity - cross(m->body_a->angular_velocity, r1) +
-                           m->body_b->velocity + cross(m->body_b->angular_velocity, r2);
-        
-        float closing_vel = dot(rel_vel, c->normal);
-        float b = -(beta / physics_dt) * c->depth + restitution * closing_vel;
-        
-        float lambda = effective_mass * (-(jv + b));
-        lambda = max(lambda, 0);
+void solve_contact_constraint(BodyStore* store, Manifold* m, Contact* c)
+{
+    solve_contact_friction(store, m, c);
+    solve_contact_normal(store, m, c);
+}
 
-        m->body_a->velocity += m->body_a->inverse_mass * j1 * lambda;
-        m->body_b->velocity += m->body_b->inverse_mass * j3 * lambda;
-        m->body_a->angular_velocity += m->body_a->inverse_inertia * j2 * lambda;
-        m->body_b->angular_velocity += m->body_b->inverse_inertia * j4 * lambda;
-    }
+/*  NOTE: Soft contact
+    The soft step replaces the baumgarte factor with a spring of a given frequency and
+    damping ratio, solved implicitly over a substep of length h (Box2D v3 b2MakeSoft):
+        omega = 2 pi hertz, a1 = 2 zeta + h omega, a2 = h omega a1, a3 = 1 / (1 + a2)
+        bias = omega / a1 * separation
+        lambda = -normal_mass * a2 a3 * (vn + bias) - a3 * accumulated
+    A stiffer spring pushes harder, the damping keeps it from bouncing. The impulse scale
+    leaks a bit of the accumulated impulse every substep, which is what makes it soft.
+*/
+struct SoftContact
+{
+    float bias_rate;
+    float mass_scale;
+    float impulse_scale;
+};
 
-#else
-    Vector3 va = m->body_a->velocity + cross(m->body_a->angular_velocity, r1);
-    Vector3 vb = m->body_b->velocity + cross(m->body_b->angular_velocity, r2);
+SoftContact make_soft_contact(float hertz, float damping_ratio, float h)
+{
+    if(hertz == 0) return {0, 1, 0};
 
-    Vector3 vab = vb - va;
+    float omega = 2.0f * PI * hertz;
+    float a1 = 2.0f * damping_ratio + h * omega;
+    float a2 = h * omega * a1;
+    float a3 = 1.0f / (1.0f + a2);
+    return {omega / a1, a2 * a3, a3};
+}
 
-    Vector3 mI = cross(m->body_a->inverse_inertia * cross(r1, c->normal), r1) + 
-                 cross(m->body_b->inverse_inertia * cross(r2, c->normal), r2);
+//NOTE: Separation from the anchors and the bodies' current transforms, the way
+//      solve_contact_position measures it. Still apart, the bodies may close the gap
+//      in this substep and no more. Penetrating past the slop the spring pushes them out
+//      with use_bias, the relax pass (without it) only removes the velocity it added
+void update_soft_contact(BodyStore* store, Manifold* m, Contact* c, SoftContact soft, float inv_h, bool use_bias)
+{
+    int a = m->index_a;
+    int b = m->index_b;
 
-    float constraint_mass = m->body_a->inverse_mass + 
-                            m->body_b->inverse_mass +
-                            dot(c->normal, mI);
+    Vector3 r1 = rotate_to_world(store->orientation[a], c->local_anchor_a);
+    Vector3 r2 = rotate_to_world(store->orientation[b], c->local_anchor_b);
+    Vector3 moved = (store->position[b] + r2) - (store->position[a] + r1);
+    float separation = dot(moved, c->normal) - c->depth + CONTACT_PENETRATION_SLOP;
 
-    if(constraint_mass > 0)
+    c->b = 0;
+    c->mass_scale = 1;
+    c->impulse_scale = 0;
+    if(separation > 0)
     {
-        float jn = max(-dot(vab, c->normal) + c->b, 0.0f);
-        jn = jn / constraint_mass;
+        c->b = separation * inv_h;
+    }
+    else if(use_bias)
+    {
+        c->b = max(soft.bias_rate * separation, -CONTACT_MAX_BIAS_VELOCITY);
+        c->mass_scale = soft.mass_scale;
+        c->impulse_scale = soft.impulse_scale;
+    }
+}
 
-        m->body_a->velocity -= c->normal * (jn * m->body_a->inverse_mass);
-        m->body_b->velocity += c->normal * (jn * m->body_b->inverse_mass);
+//NOTE: Soft step only, runs once after the substeps. The bodies leave the contact with
+//      the bounce prepare_contact asked for
+void solve_contact_restitution(BodyStore* store, Manifold* m, Contact* c)
+{
+    if(!(c->restitution_bias < 0) || c->normal_mass <= 0) return;
 
-        m->body_a->angular_velocity -= m->body_a->inverse_inertia * cross(r1, c->normal * jn);
-        m->body_b->angular_velocity += m->body_b->inverse_inertia * cross(r2, c->normal * jn);
-    }
+    float lambda = -(dot(get_relative_velocity(store, m, c), c->normal) + c->restitution_bias) * c->normal_mass;
 
-    //Friction
-    Vector3 tangent = vab - c->normal * dot(vab, c->normal);
-    float tangent_length = length(tangent);
+    float old_sum = c->sum_impulse_contact;
+    c->sum_impulse_contact = max(old_sum + lambda, 0);
+
+    apply_contact_impulse(store, m, c, c->normal * (c->sum_impulse_contact - old_sum));
+}
 
-    if(tangent_length > 1e-6f)
+/*  NOTE: Block solver
+    The two contacts of a resting box push against each other, one after the other they
+    keep handing impulse back and forth and a stack needs many iterations to stop rocking.
+    Solving both normal rows together is the 2x2 LCP
+        vn = K * x + b,  x >= 0,  vn >= 0,  x . vn = 0
+    where K[i][j] is the velocity along n at contact i from a unit impulse at contact j.
+    prepare_contact_block keeps K when it is well conditioned, the contacts are too close
+    together otherwise and they are solved one after the other as before.
+    Reference: Box2D b2ContactSolver::SolveVelocityConstraints
+*/
+void prepare_contact_block(BodyStore* store, Manifold* m)
+{
+    m->block_solve = false;
+    if(m->contact_count != 2) return;
+
+    Contact* c1 = &m->contacts[0];
+    Contact* c2 = &m->contacts[1];
+    if(c1->normal_mass <= 0 || c2->normal_mass <= 0) return;
+
+    int a = m->index_a;
+    int b = m->index_b;
+    float inverse_mass = store->inverse_mass[a] + store->inverse_mass[b];
+    float k11 = inverse_mass;
+    float k12 = inverse_mass * dot(c1->normal, c2->normal);
+    float k22 = inverse_mass;
+    if(can_rotate(store, a))
+    {
+        Angular j1 = cross_angular(c1->rel_pos_a, c1->normal);
+        Angular j2 = cross_angular(c2->rel_pos_a, c2->normal);
+        k11 += dot_angular(j1, store->inverse_inertia[a] * j1);
+        k12 += dot_angular(j1, store->inverse_inertia[a] * j2);
+        k22 += dot_angular(j2, store->inverse_inertia[a] * j2);
+    }
+    if(can_rotate(store, b))
     {
-        tangent = tangent / tangent_length;
-        float d = dot(tangent, cross(m->body_a->inverse_inertia * cross(r1, tangent), r1) + cross(m->body_b->inverse_inertia * cross(r2, tangent), r2));
+        Angular j1 = cross_angular(c1->rel_pos_b, c1->normal);
+        Angular j2 = cross_angular(c2->rel_pos_b, c2->normal);
+        k11 += dot_angular(j1, store->inverse_inertia[b] * j1);
+        k12 += dot_angular(j1, store->inverse_inertia[b] * j2);
+        k22 += dot_angular(j2, store->inverse_inertia[b] * j2);
+    }
+
+    float det = k11 * k22 - k12 * k12;
+    if(!(k11 * k11 < CONTACT_BLOCK_MAX_CONDITION * det)) return;
 
-        float friction_mass = m->body_a->inverse_mass + m->body_b->inverse_mass + d;
+    m->block_solve = true;
+    m->block_k[0] = k11;
+    m->block_k[1] = k12;
+    m->block_k[2] = k22;
+    m->block_mass[0] = k22 / det;
+    m->block_mass[1] = -k12 / det;
+    m->block_mass[2] = k11 / det;
+}
 
-        if(friction_mass > 0)
+//NOTE: Tries the four ways the LCP can come out, both contacts pushing, only the first,
+//      only the second and neither. When none fits (only from round off) nothing changes
+void solve_contact_block(BodyStore* store, Manifold* m)
+{
+    Contact* c1 = &m->contacts[0];
+    Contact* c2 = &m->contacts[1];
+    float k11 = m->block_k[0];
+    float k12 = m->block_k[1];
+    float k22 = m->block_k[2];
+
+    float a1 = c1->sum_impulse_contact;
+    float a2 = c2->sum_impulse_contact;
+
+    //NOTE: Velocities the rows would have with no accumulated impulse at all
+    float b1 = dot(get_relative_velocity(store, m, c1), c1->normal) + c1->b - (k11 * a1 + k12 * a2);
+    float b2 = dot(get_relative_velocity(store, m, c2), c2->normal) + c2->b - (k12 * a1 + k22 * a2);
+
+    float x1 = -(m->block_mass[0] * b1 + m->block_mass[1] * b2);
+    float x2 = -(m->block_mass[1] * b1 + m->block_mass[2] * b2);
+    if(!(x1 >= 0 && x2 >= 0))
+    {
+        x1 = -c1->normal_mass * b1;
+        x2 = 0;
+        if(!(x1 >= 0 && k12 * x1 + b2 >= 0))
         {
-            float friction_coeff = m->body_a->friction * m->body_b->friction;
-            float jt = -dot(vab, tangent) * friction_coeff;
-            jt = jt / friction_mass;
+            x1 = 0;
+            x2 = -c2->normal_mass * b2;
+            if(!(x2 >= 0 && k12 * x2 + b1 >= 0))
+            {
+                x1 = 0;
+                x2 = 0;
+                if(!(b1 >= 0 && b2 >= 0)) return;
+            }
+        }
+    }
+
+    c1->sum_impulse_contact = x1;
+    c2->sum_impulse_contact = x2;
+    apply_contact_impulse(store, m, c1, c1->normal * (x1 - a1));
+    apply_contact_impulse(store, m, c2, c2->normal * (x2 - a2));
+}
+
+//NOTE: Nonlinear position correction, pushes the bodies apart directly along the normal
+//      using the penetration recomputed from the current transforms. Returns the penetration
+float solve_contact_position(BodyStore* store, Manifold* m, Contact* c)
+{
+    int a = m->index_a;
+    int b = m->index_b;
 
-            m->body_a->velocity -= tangent * (jt * m->body_a->inverse_mass);
-            m->body_b->velocity += tangent * (jt * m->body_b->inverse_mass);
+    Vector3 r1 = rotate_to_world(store->orientation[a], c->local_anchor_a);
+    Vector3 r2 = rotate_to_world(store->orientation[b], c->local_anchor_b);
 
-            m->body_a->angular_velocity -= m->body_a->inverse_inertia * cross(r1, tangent * jt);
-            m->body_b->angular_velocity += m->body_b->inverse_inertia * cross(r2, tangent * jt);
-        }                      
+    Vector3 moved = (store->position[b] + r2) - (store->position[a] + r1);
+    float penetration = c->depth - dot(moved, c->normal);
+
+    float correction = clamp(CONTACT_POSITION_BAUMGARTE * (penetration - CONTACT_PENETRATION_SLOP), 0, CONTACT_MAX_CORRECTION);
+    float effective_mass = get_effective_mass(store, m, r1, r2, c->normal);
+
+    if(correction > 0 && effective_mass > 0)
+    {
+        Vector3 p = c->normal * (correction * effective_mass);
+
+        if(store->inverse_mass[a] != 0)
+        {
+            store->position[a] -= p * store->inverse_mass[a];
+            if(can_rotate(store, a))
+                store->orientation[a] = rotate_orientation(store->orientation[a], store->inverse_inertia[a] * cross_angular(r1, p));
+        }
+        if(store->inverse_mass[b] != 0)
+        {
+            store->position[b] += p * store->inverse_mass[b];
+            if(can_rotate(store, b))
+                store->orientation[b] = rotate_orientation(store->orientation[b], -(store->inverse_inertia[b] * cross_angular(r2, p)));
+        }
     }
-#endif
+
+    return penetration;
 }
 
 #endif
\ No newline at end of file
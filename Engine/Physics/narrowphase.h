@@ -0,0 +1,56 @@
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include "sat.h"
+#include "circle.h"
+#include "gjk.h"
+#ifndef PHYSICS_3D
+#include "simd_box_box.h"
+#endif
+
+/*  NOTE: Narrowphase dispatch
+    Every (ShapeType, ShapeType) pair has its own contact routine, row is the type of
+    body a. find_collisions groups its pairs by table entry so each routine runs over all
+    of its pairs back to back. A new shape type needs a new row and column here.
+*/
+typedef bool (*NarrowphaseFunction)(RigidBody* body_a, RigidBody* body_b, Manifold* manifold);
+
+#define NARROWPHASE_KERNEL_COUNT (SHAPE_TYPE_COUNT * SHAPE_TYPE_COUNT)
+
+//NOTE: Entry find_collisions hands to collide_box_box_batch when a SIMD path is available
+#define BOX_BOX_ENTRY (ShapeType::RECTANGLE * SHAPE_TYPE_COUNT + ShapeType::RECTANGLE)
+
+#ifdef PHYSICS_3D
+//NOTE: The quaternion update_shape can shear a box, so boxes take the general polygon test
+#define BOX_BOX_KERNEL test_SAT
+#else
+#define BOX_BOX_KERNEL test_box_box
+#endif
+
+//NOTE: Custom polygons go through GJK, up to SHAPE_MAX_VERTICES a side SAT projects every
+//      vertex on every axis while GJK climbs to the supports, and EPA's depth stays exact
+//      where SAT's interval overlap comes up short for a deep pair
+static NarrowphaseFunction narrowphase_table[SHAPE_TYPE_COUNT][SHAPE_TYPE_COUNT] =
+{
+    //             RECTANGLE            TRIANGLE             RIGHT_TRIANGLE       CIRCLE                CUSTOM
+    /*RECTANGLE*/  {BOX_BOX_KERNEL,      test_SAT,            test_SAT,            test_polygon_circle,  test_gjk},
+    /*TRIANGLE*/   {test_SAT,            test_SAT,            test_SAT,            test_polygon_circle,  test_gjk},
+    /*RIGHT_TRI*/  {test_SAT,            test_SAT,            test_SAT,            test_polygon_circle,  test_gjk},
+    /*CIRCLE*/     {test_circle_polygon, test_circle_polygon, test_circle_polygon, test_circle_circle,   test_circle_polygon},
+    /*CUSTOM*/     {test_gjk,            test_gjk,            test_gjk,            test_polygon_circle,  test_gjk},
+};
+
+inline int get_narrowphase_kernel(RigidBody* body_a, RigidBody* body_b)
+{
+    return body_a->shape.type * SHAPE_TYPE_COUNT + body_b->shape.type;
+}
+
+//NOTE: Single pair entry point, find_collisions goes through the table in batches instead.
+//      Without a broadphase in front most pairs are far apart, the bounds reject those
+bool test_collision(RigidBody* body_a, RigidBody* body_b, Manifold* manifold)
+{
+    if(!shape_bounds_overlap(&body_a->shape, &body_b->shape)) return false;
+    return narrowphase_table[body_a->shape.type][body_b->shape.type](body_a, body_b, manifold);
+}
+
+#endif
@@ -5,23 +5,29 @@ RigidBody create_body(Shape shape, Vector3 p, Vector3 v, float mass)
     RigidBody body = {};
     body.position = p;
     body.velocity = v;
-    body.orientation = make_quaternion({}, 1.0f);
+    body.orientation = make_rotation(0);
     body.inverse_mass = mass > 0 ? 1.0f / mass : 0;
-    Mat3 inertia_tensor = {};
 
+    //NOTE: The prototype's second moment is 1/12 on both axes for the rectangle, the old
+    //      box formula. Triangles get their own instead of the box's
     if(mass != 0)
     {
-        float oneTwelve = 1.0f / 12.0f;
-        float xx = shape.dim.x * shape.dim.x;
-        float yy = shape.dim.y * shape.dim.y;
-        inertia_tensor._11 = oneTwelve * mass * (yy);
-        inertia_tensor._22 = oneTwelve * mass * (xx);
-        inertia_tensor._33 = oneTwelve * mass * (xx + yy);
+        Vector2 moment = get_shape_prototype(&shape)->second_moment;
+        float xx = moment.x * shape.dim.x * shape.dim.x;
+        float yy = moment.y * shape.dim.y * shape.dim.y;
+#ifdef PHYSICS_3D
+        Mat3 inertia_tensor = {};
+        inertia_tensor._11 = mass * (yy);
+        inertia_tensor._22 = mass * (xx);
+        inertia_tensor._33 = mass * (xx + yy);
         body.inverse_inertia = inverse(inertia_tensor);
+#else
+        body.inverse_inertia = 1.0f / (mass * (xx + yy));
+#endif
     }
     
+    //NOTE: No vertices yet, add_body gives the shape its place in the world's buffers
     body.shape = shape;
-    update_shape(&body.shape, p, body.orientation);
 
     return body;
 }
@@ -36,6 +42,31 @@ void set_damping_factor(float k)
     physics_damping_factor = k;
 }
 
+void set_warm_starting(bool enabled)
+{
+    physics_warm_starting = enabled;
+}
+
+void set_block_solving(bool enabled)
+{
+    physics_block_solving = enabled;
+}
+
+void set_contact_refresh(bool enabled)
+{
+    physics_contact_refresh = enabled;
+}
+
+void set_sleeping(bool enabled)
+{
+    physics_allow_sleeping = enabled;
+}
+
+void set_grid_cell_size(PhysicsWorld* world, float cell_size)
+{
+    world->grid.cell_size = cell_size;
+}
+
 void integrate_for_velocity(RigidBody* body, float dt)
 {
     if(body->inverse_mass > 0)
@@ -59,13 +90,1272 @@ void integrate_for_position(RigidBody* body, float dt)
     
     if(!body->freeze_orientation)
     {
-        body->orientation = body->orientation + make_quaternion(body->angular_velocity * dt * 0.5f, 0) * body->orientation;
+        body->orientation = rotate_orientation(body->orientation, body->angular_velocity * dt);
     }
     update_shape(&body->shape, body->position, body->orientation);
-    body->orientation = normalize(body->orientation);
 }
 
-void solve_distance_constraint(DistanceConstraint* c, float dt)
+void integrate_for_velocity(PhysicsWorld* world, float dt)
+{
+    integrate_velocity(&world->store, world->integrator, dt, physics_damping_factor);
+}
+
+//NOTE: Also refits the AABB tree, proxies only get reinserted once a body leaves its fat AABB.
+//      Sweep and prune reads every box in update_pairs instead
+void integrate_for_position(PhysicsWorld* world, float dt)
+{
+    integrate_position(&world->store, world->integrator, dt);
+    update_body_shapes(world, dt);
+}
+
+//NOTE: Shapes and proxies follow the bodies once per step, also after the substeps
+void update_body_shapes(PhysicsWorld* world, float dt)
+{
+    BodyStore* store = &world->store;
+    Vector3* position = store->position.data();
+    Vector3* velocity = store->velocity.data();
+    Rotation* orientation = store->orientation.data();
+    u32* flags = store->flags.data();
+
+    for(int i = 0; i < store->count; ++i)
+    {
+        if(flags[i] & BODY_SLEEPING) continue;
+
+        RigidBody* body = &world->bodies[i];
+        update_shape(&body->shape, position[i], orientation[i]);
+        if(world->broadphase == BroadphaseType::AABB_TREE)
+        {
+            move_proxy(&world->tree, body->proxy, body->shape.aabb, velocity[i].xy * dt);
+        }
+    }
+}
+
+void init_physics_world(PhysicsWorld* world, BroadphaseType broadphase)
+{
+    world->bodies.clear();
+    init_body_store(&world->store);
+    world->manifolds.clear();
+    world->old_manifolds.clear();
+    world->manifold_order.clear();
+    world->old_manifold_order.clear();
+    world->sat_axes.clear();
+    world->old_sat_axes.clear();
+    world->gjk_caches.clear();
+    world->old_gjk_caches.clear();
+    world->shape_vertices.clear();
+    world->shape_normals.clear();
+    world->constraints.clear();
+    world->pairs.clear();
+    world->broadphase = broadphase;
+    init_aabb_tree(&world->tree);
+    init_sap(&world->sap);
+    init_grid(&world->grid);
+    world->stats = {};
+    set_solver_iterations(world, SOLVER_DEFAULT_VELOCITY_ITERATIONS, SOLVER_DEFAULT_POSITION_ITERATIONS);
+    set_solver_substeps(world, 0);
+    world->integrator = get_supported_integrator_path();
+}
+
+void destroy_physics_world(PhysicsWorld* world)
+{
+    for(RigidBody& body : world->bodies)
+    {
+        destroy_shape(&body.shape);
+    }
+    destroy_thread_pool(&world->pool);
+}
+
+//NOTE: Body i's vertices follow body i - 1's in the shape buffers
+void bind_shape_buffers(PhysicsWorld* world)
+{
+    int first = 0;
+    for(RigidBody& body : world->bodies)
+    {
+        body.shape.global_vertices = world->shape_vertices.data() + first;
+        body.shape.global_normals = world->shape_normals.data() + first;
+        first += body.shape.vertices_count;
+    }
+}
+
+//NOTE: Threads used on top of the calling thread, 0 keeps the step single threaded
+void set_worker_threads(PhysicsWorld* world, int worker_count)
+{
+    init_thread_pool(&world->pool, worker_count);
+}
+
+//NOTE: The world holds its own reference to the body's shape prototype and releases it in
+//      destroy_physics_world, the caller still destroys the shape it created
+int add_body(PhysicsWorld* world, RigidBody body)
+{
+    int index = (int)world->bodies.size();
+    acquire_shape_prototype(body.shape.prototype);
+
+    //NOTE: Growing the buffers moves every body's vertices, the shapes are pointed at the new
+    //      place. It happens as often as a vector reallocates, so spawning stays allocation free
+    //      most of the time
+    int first = (int)world->shape_vertices.size();
+    Vector3* old_vertices = world->shape_vertices.data();
+    Vector3* old_normals = world->shape_normals.data();
+    world->shape_vertices.resize(first + body.shape.vertices_count);
+    world->shape_normals.resize(first + body.shape.vertices_count);
+    if(world->shape_vertices.data() != old_vertices || world->shape_normals.data() != old_normals)
+    {
+        bind_shape_buffers(world);
+    }
+    body.shape.global_vertices = world->shape_vertices.data() + first;
+    body.shape.global_normals = world->shape_normals.data() + first;
+    update_shape(&body.shape, body.position, body.orientation);
+
+    switch(world->broadphase)
+    {
+        case BroadphaseType::AABB_TREE:
+        {
+            body.proxy = create_proxy(&world->tree, body.shape.aabb, index);
+        } break;
+        case BroadphaseType::SWEEP_AND_PRUNE:
+        {
+            body.proxy = sap_add_box(&world->sap, body.shape.aabb);
+        } break;
+        case BroadphaseType::UNIFORM_GRID:
+        {
+            body.proxy = grid_add_box(&world->grid, body.shape.aabb);
+        } break;
+    }
+    world->bodies.push_back(body);
+
+    u32 flags = body.freeze_orientation ? BODY_FREEZE_ORIENTATION : 0;
+    body_store_add(&world->store, body.position, body.velocity, body.orientation, body.angular_velocity,
+                   body.inverse_mass, body.inverse_inertia, flags);
+    world->store.force[index] = body.force;
+    world->store.torque[index] = body.torgue;
+
+    return index;
+}
+
+Vector3 get_body_position(PhysicsWorld* world, int body)
+{
+    return world->store.position[body];
+}
+
+Rotation get_body_orientation(PhysicsWorld* world, int body)
+{
+    return world->store.orientation[body];
+}
+
+Vector3 get_body_velocity(PhysicsWorld* world, int body)
+{
+    return world->store.velocity[body];
+}
+
+Angular get_body_angular_velocity(PhysicsWorld* world, int body)
+{
+    return world->store.angular_velocity[body];
+}
+
+void set_body_velocity(PhysicsWorld* world, int body, Vector3 v)
+{
+    world->store.velocity[body] = v;
+}
+
+void set_body_angular_velocity(PhysicsWorld* world, int body, Angular w)
+{
+    world->store.angular_velocity[body] = w;
+}
+
+void set_body_force(PhysicsWorld* world, int body, Vector3 force)
+{
+    world->store.force[body] = force;
+}
+
+void set_body_torque(PhysicsWorld* world, int body, Angular torque)
+{
+    world->store.torque[body] = torque;
+}
+
+bool is_body_sleeping(PhysicsWorld* world, int body)
+{
+    return is_sleeping(&world->store, body);
+}
+
+void wake_body(PhysicsWorld* world, int body)
+{
+    wake_body(&world->store, body);
+}
+
+void add_constraint(PhysicsWorld* world, Constraint c)
+{
+    world->constraints.push_back(c);
+}
+
+//NOTE: -1 when the constraint type has no body pair
+void get_constraint_bodies(Constraint* c, int* body_a, int* body_b)
+{
+    switch(c->type)
+    {
+        case ConstraintType::DISTANCE:
+        {
+            DistanceConstraint* d = (DistanceConstraint*)c->constraint;
+            *body_a = d->body_a;
+            *body_b = d->body_b;
+        } break;
+        default:
+        {
+            *body_a = -1;
+            *body_b = -1;
+        } break;
+    }
+}
+
+int get_slice_count(PhysicsWorld* world, int work_count)
+{
+    int slice_count = get_thread_count(&world->pool) == 1 ? 1 : get_thread_count(&world->pool) * BROADPHASE_SLICES_PER_THREAD;
+    slice_count = max(min(slice_count, work_count), 1);
+    if((int)world->slice_pairs.size() < slice_count)
+    {
+        world->slice_pairs.resize(slice_count);
+    }
+
+    return slice_count;
+}
+
+void merge_slice_pairs(PhysicsWorld* world, int slice_count)
+{
+    world->pairs.clear();
+    for(int i = 0; i < slice_count; ++i)
+    {
+        world->pairs.insert(world->pairs.end(), world->slice_pairs[i].begin(), world->slice_pairs[i].end());
+    }
+}
+
+//NOTE: The tree and the grid query in parallel slices when the world has worker threads.
+//      Sweep and prune is incremental and stays on the calling thread
+void update_pairs(PhysicsWorld* world)
+{
+    switch(world->broadphase)
+    {
+        case BroadphaseType::AABB_TREE:
+        {
+            //NOTE: Slices are contiguous body ranges and every pair starts with the querying
+            //      body, so sorting each slice and concatenating them is already in order
+            int body_count = (int)world->bodies.size();
+            int slice_count = get_slice_count(world, body_count);
+            parallel_for(&world->pool, slice_count, [world, body_count, slice_count](int slice)
+            {
+                std::vector<BroadphasePair>* pairs = &world->slice_pairs[slice];
+                pairs->clear();
+
+                int first = (int)((s64)body_count * slice / slice_count);
+                int last = (int)((s64)body_count * (slice + 1) / slice_count);
+                for(int i = first; i < last; ++i)
+                {
+                    query_proxy_pairs(&world->tree, world->bodies[i].proxy, pairs);
+                }
+                sort_pairs(pairs);
+            });
+            merge_slice_pairs(world, slice_count);
+        } break;
+        case BroadphaseType::SWEEP_AND_PRUNE:
+        {
+            for(RigidBody& body : world->bodies)
+            {
+                world->sap.boxes[body.proxy] = body.shape.aabb;
+            }
+            sap_update(&world->sap);
+            sap_apply_pair_events(&world->sap, &world->pairs);
+        } break;
+        case BroadphaseType::UNIFORM_GRID:
+        {
+            for(RigidBody& body : world->bodies)
+            {
+                world->grid.boxes[body.proxy] = body.shape.aabb;
+            }
+            grid_build(&world->grid);
+
+            u32 bucket_count = world->grid.table_mask + 1;
+            int slice_count = get_slice_count(world, (int)bucket_count);
+            parallel_for(&world->pool, slice_count, [world, bucket_count, slice_count](int slice)
+            {
+                std::vector<BroadphasePair>* pairs = &world->slice_pairs[slice];
+                pairs->clear();
+
+                u32 first = (u32)((u64)bucket_count * slice / slice_count);
+                u32 last = (u32)((u64)bucket_count * (slice + 1) / slice_count);
+                grid_find_pairs_in_buckets(&world->grid, first, last, pairs);
+            });
+            merge_slice_pairs(world, slice_count);
+            sort_pairs(&world->pairs);
+        } break;
+    }
+
+    world->stats.broadphase_pairs = (int)world->pairs.size();
+}
+
+//NOTE: Pairs come out of every broadphase sorted, manifold_order lists the manifolds in
+//      pair_key order so last frame's manifold for a pair is found by walking both together
+Manifold* find_old_manifold(PhysicsWorld* world, u64 key, int* cursor)
+{
+    ManifoldRef* order = world->old_manifold_order.data();
+    int count = (int)world->old_manifold_order.size();
+    while(*cursor < count && order[*cursor].key < key)
+    {
+        ++*cursor;
+    }
+
+    if(*cursor < count && order[*cursor].key == key)
+    {
+        return &world->old_manifolds[order[*cursor].index];
+    }
+    return 0;
+}
+
+//NOTE: Fills in the last manifold the narrowphase appended for pair i, warm starts it from
+//      last frame's and wakes its bodies
+void finish_new_manifold(PhysicsWorld* world, int i, int* old_cursor)
+{
+    BodyStore* store = &world->store;
+    BroadphasePair pair = world->pairs[i];
+    Manifold* m = &world->manifolds.back();
+
+    m->key = pair_key(pair.a, pair.b);
+    m->index_a = pair.a;
+    m->index_b = pair.b;
+    m->friction = m->body_a->friction * m->body_b->friction;
+    m->restitution = m->body_a->restitution * m->body_b->restitution;
+    set_contact_anchors(store, m);
+
+    Manifold* old_m = find_old_manifold(world, m->key, old_cursor);
+    if(physics_warm_starting && old_m)
+    {
+        match_contacts(m, old_m);
+    }
+
+    //NOTE: An awake body touching a sleeping one wakes it, update_sleep wakes
+    //      the rest of its island at the end of the step
+    if(is_sleeping(store, pair.a)) wake_body(store, pair.a);
+    if(is_sleeping(store, pair.b)) wake_body(store, pair.b);
+
+    world->pair_manifolds[i] = (int)world->manifolds.size() - 1;
+}
+
+int find_cached_sat_axis(PhysicsWorld* world, u64 key, int* cursor)
+{
+    SatAxisRef* axes = world->old_sat_axes.data();
+    int count = (int)world->old_sat_axes.size();
+    while(*cursor < count && axes[*cursor].key < key)
+    {
+        ++*cursor;
+    }
+
+    if(*cursor < count && axes[*cursor].key == key)
+    {
+        return axes[*cursor].axis;
+    }
+    return SAT_AXIS_NONE;
+}
+
+//NOTE: Same walk as find_cached_sat_axis, a cache with count 0 when the pair has none
+GjkCache find_cached_gjk(PhysicsWorld* world, u64 key, int* cursor)
+{
+    GjkCacheRef* caches = world->old_gjk_caches.data();
+    int count = (int)world->old_gjk_caches.size();
+    while(*cursor < count && caches[*cursor].key < key)
+    {
+        ++*cursor;
+    }
+
+    if(*cursor < count && caches[*cursor].key == key)
+    {
+        return caches[*cursor].cache;
+    }
+    return {};
+}
+
+#ifndef PHYSICS_3D
+//NOTE: The box vs box batch goes through the SIMD axis tests BOX_BOX_LANES pairs at a
+//      time, only the pairs that didn't separate reach the clipping. Every pair starts
+//      from its cached axis and leaves the deciding one in pair_sat_axes like the other
+//      kernels. Returns how many separated, the axes they tested go into sat_axes_tested
+int collide_box_box_batch(PhysicsWorld* world, int* batch, int count, int* old_cursor, int* sat_axes_tested)
+{
+    int separated = 0;
+    int axis_cursor = 0;
+    BoxBoxLanes lanes;
+    for(int first = 0; first < count; first += BOX_BOX_LANES)
+    {
+        int last = min(first + BOX_BOX_LANES, count);
+        lanes.count = 0;
+        for(int j = first; j < last; ++j)
+        {
+            BroadphasePair pair = world->pairs[batch[j]];
+            int cached = find_cached_sat_axis(world, pair_key(pair.a, pair.b), &axis_cursor);
+            add_box_box_lane(&lanes, &world->bodies[pair.a].shape, &world->bodies[pair.b].shape, cached);
+        }
+
+        sat_box_box_lanes(&lanes, world->integrator);
+
+        for(int j = first; j < last; ++j)
+        {
+            int lane = j - first;
+            world->pair_sat_axes[batch[j]] = get_box_box_sat_axis(lanes.sat_axis[lane]);
+            *sat_axes_tested += lanes.axes_tested[lane];
+            if(lanes.axis[lane] < 0)
+            {
+                ++separated;
+                continue;
+            }
+
+            BroadphasePair pair = world->pairs[batch[j]];
+            world->manifolds.push_back({});
+            set_box_box_lane_manifold(&lanes, lane, &world->bodies[pair.a], &world->bodies[pair.b], &world->manifolds.back());
+            finish_new_manifold(world, batch[j], old_cursor);
+        }
+    }
+
+    return separated;
+}
+#endif
+
+/*  NOTE: Narrowphase
+    Runs in three passes over the sorted pairs:
+    1. Each pair is skipped (two static bodies or bounds that don't touch), keeps last
+       frame's manifold (nothing in it is awake), gets last frame's manifold moved along
+       with the bodies (see refresh_manifold) or gets the narrowphase_table entry for its
+       shape types. The pairs to test are counting sorted by entry into pair_batches.
+    2. Every table entry runs over its batch with the pair's cached SAT axis and GJK
+       simplex, hits are appended to manifolds and warm started from the old manifold. A
+       batch is still in pair order, so each one walks old_manifold_order, old_sat_axes
+       and old_gjk_caches from the start.
+    3. The pairs are walked in order again to copy the kept manifolds and fill in
+       manifold_order, sat_axes and gjk_caches.
+*/
+#define PAIR_SKIP 0xFF
+#define PAIR_KEEP_OLD 0xFE
+#define PAIR_REFRESHED 0xFD
+
+//NOTE: Appends last frame's manifold of pair i moved along with its bodies, the pair
+//      isn't tested this frame. False when there is none or it drifted too far
+bool refresh_old_manifold(PhysicsWorld* world, int i, int* old_cursor, int* axis_cursor, int* gjk_cursor)
+{
+    if(!physics_contact_refresh) return false;
+
+    BodyStore* store = &world->store;
+    BroadphasePair pair = world->pairs[i];
+    u64 key = pair_key(pair.a, pair.b);
+    Manifold* old_m = find_old_manifold(world, key, old_cursor);
+    if(!old_m) return false;
+
+    world->manifolds.push_back(*old_m);
+    Manifold* m = &world->manifolds.back();
+    if(!refresh_manifold(store, m))
+    {
+        world->manifolds.pop_back();
+        return false;
+    }
+
+    m->body_a = &world->bodies[pair.a];
+    m->body_b = &world->bodies[pair.b];
+    if(is_sleeping(store, pair.a)) wake_body(store, pair.a);
+    if(is_sleeping(store, pair.b)) wake_body(store, pair.b);
+
+    world->pair_manifolds[i] = (int)world->manifolds.size() - 1;
+    world->pair_sat_axes[i] = find_cached_sat_axis(world, key, axis_cursor);
+    world->pair_gjk_caches[i] = find_cached_gjk(world, key, gjk_cursor);
+    return true;
+}
+
+void find_collisions(PhysicsWorld* world)
+{
+    update_pairs(world);
+
+#ifdef PHYSICS_COUNT_ALLOCATIONS
+    u64 allocations = physics_allocation_count.load();
+#endif
+
+    //NOTE: The manifold arrays are the contact slab, a pair makes at most one manifold so
+    //      they only grow when the broadphase finds more pairs than any frame before
+    int pair_count = (int)world->pairs.size();
+    world->old_manifolds.swap(world->manifolds);
+    world->old_manifold_order.swap(world->manifold_order);
+    world->old_sat_axes.swap(world->sat_axes);
+    world->sat_axes.clear();
+    world->sat_axes.reserve(pair_count);
+    world->old_gjk_caches.swap(world->gjk_caches);
+    world->gjk_caches.clear();
+    world->gjk_caches.reserve(pair_count);
+    world->manifolds.clear();
+    world->manifolds.reserve(pair_count);
+    world->manifold_order.clear();
+    world->manifold_order.reserve(pair_count);
+    world->pair_kernels.resize(pair_count);
+    world->pair_batches.resize(pair_count);
+    world->pair_manifolds.resize(pair_count);
+    world->pair_sat_axes.resize(pair_count);
+    world->pair_gjk_caches.resize(pair_count);
+
+    BodyStore* store = &world->store;
+    BroadphasePair* pairs = world->pairs.data();
+    u8* pair_kernels = world->pair_kernels.data();
+    int* pair_batches = world->pair_batches.data();
+    int* pair_manifolds = world->pair_manifolds.data();
+    int* pair_sat_axes = world->pair_sat_axes.data();
+    GjkCache* pair_gjk_caches = world->pair_gjk_caches.data();
+
+    int batch_first[NARROWPHASE_KERNEL_COUNT + 1] = {};
+    int bounds_rejected = 0;
+    int refreshed = 0;
+    int refresh_cursor = 0;
+    int refresh_axis_cursor = 0;
+    int refresh_gjk_cursor = 0;
+    for(int i = 0; i < pair_count; ++i)
+    {
+        int a = pairs[i].a;
+        int b = pairs[i].b;
+        pair_manifolds[i] = -1;
+        pair_sat_axes[i] = SAT_AXIS_NONE;
+        pair_gjk_caches[i].count = 0;
+
+        //NOTE: Two static bodies can't generate a response, nothing moved between sleeping
+        //      (or static) bodies so their old manifold is kept to hold the island together
+        if(store->inverse_mass[a] == 0 && store->inverse_mass[b] == 0)
+        {
+            pair_kernels[i] = PAIR_SKIP;
+        }
+        else if(!is_active(store, a) && !is_active(store, b))
+        {
+            pair_kernels[i] = PAIR_KEEP_OLD;
+        }
+        else if(!shape_bounds_overlap(&world->bodies[a].shape, &world->bodies[b].shape))
+        {
+            pair_kernels[i] = PAIR_SKIP;
+            ++bounds_rejected;
+        }
+        else if(refresh_old_manifold(world, i, &refresh_cursor, &refresh_axis_cursor, &refresh_gjk_cursor))
+        {
+            pair_kernels[i] = PAIR_REFRESHED;
+            ++refreshed;
+        }
+        else
+        {
+            int kernel = get_narrowphase_kernel(&world->bodies[a], &world->bodies[b]);
+            pair_kernels[i] = (u8)kernel;
+            ++batch_first[kernel + 1];
+        }
+    }
+
+    for(int k = 0; k < NARROWPHASE_KERNEL_COUNT; ++k)
+    {
+        batch_first[k + 1] += batch_first[k];
+    }
+    world->stats.pair_tests = batch_first[NARROWPHASE_KERNEL_COUNT];
+    world->stats.bounds_rejected = bounds_rejected;
+    world->stats.contact_refreshes = refreshed;
+    world->stats.box_box_separated = 0;
+    int sat_axes_tested = 0;
+
+    int batch_next[NARROWPHASE_KERNEL_COUNT];
+    memcpy(batch_next, batch_first, sizeof(batch_next));
+    for(int i = 0; i < pair_count; ++i)
+    {
+        if(pair_kernels[i] < NARROWPHASE_KERNEL_COUNT)
+        {
+            pair_batches[batch_next[pair_kernels[i]]++] = i;
+        }
+    }
+
+    for(int k = 0; k < NARROWPHASE_KERNEL_COUNT; ++k)
+    {
+        int old_cursor = 0;
+#ifndef PHYSICS_3D
+        if(k == BOX_BOX_ENTRY && world->integrator != INTEGRATOR_SCALAR)
+        {
+            world->stats.box_box_separated = collide_box_box_batch(world, pair_batches + batch_first[k], batch_first[k + 1] - batch_first[k], &old_cursor,
+                                                                   &sat_axes_tested);
+            continue;
+        }
+#endif
+
+        NarrowphaseFunction collide = narrowphase_table[k / SHAPE_TYPE_COUNT][k % SHAPE_TYPE_COUNT];
+        int axis_cursor = 0;
+        int gjk_cursor = 0;
+        for(int j = batch_first[k]; j < batch_first[k + 1]; ++j)
+        {
+            int i = pair_batches[j];
+            u64 key = pair_key(pairs[i].a, pairs[i].b);
+            world->manifolds.push_back({});
+            Manifold* m = &world->manifolds.back();
+            m->sat_axis = find_cached_sat_axis(world, key, &axis_cursor);
+            m->gjk_cache = find_cached_gjk(world, key, &gjk_cursor);
+
+            bool hit = collide(&world->bodies[pairs[i].a], &world->bodies[pairs[i].b], m);
+            pair_sat_axes[i] = m->sat_axis;
+            pair_gjk_caches[i] = m->gjk_cache;
+            sat_axes_tested += m->sat_axes_tested;
+            if(hit)
+            {
+                finish_new_manifold(world, i, &old_cursor);
+            }
+            else
+            {
+                world->manifolds.pop_back();
+            }
+        }
+    }
+
+    int old_cursor = 0;
+    int axis_cursor = 0;
+    int gjk_cursor = 0;
+    for(int i = 0; i < pair_count; ++i)
+    {
+        BroadphasePair pair = pairs[i];
+        u64 key = pair_key(pair.a, pair.b);
+
+        if(pair_kernels[i] == PAIR_KEEP_OLD)
+        {
+            //NOTE: Untested pairs hold on to their axis and simplex for when they wake up
+            pair_sat_axes[i] = find_cached_sat_axis(world, key, &axis_cursor);
+            pair_gjk_caches[i] = find_cached_gjk(world, key, &gjk_cursor);
+
+            Manifold* old_m = find_old_manifold(world, key, &old_cursor);
+            if(old_m)
+            {
+                old_m->body_a = &world->bodies[pair.a];
+                old_m->body_b = &world->bodies[pair.b];
+                world->manifold_order.push_back({key, (int)world->manifolds.size()});
+                world->manifolds.push_back(*old_m);
+            }
+        }
+        else if(pair_manifolds[i] >= 0)
+        {
+            world->manifold_order.push_back({key, pair_manifolds[i]});
+        }
+
+        if(pair_sat_axes[i] != SAT_AXIS_NONE)
+        {
+            world->sat_axes.push_back({key, pair_sat_axes[i]});
+        }
+        if(pair_gjk_caches[i].count > 0)
+        {
+            world->gjk_caches.push_back({key, pair_gjk_caches[i]});
+        }
+    }
+
+    world->stats.manifolds = (int)world->manifolds.size();
+    world->stats.sat_axes_tested = sat_axes_tested;
+#ifdef PHYSICS_COUNT_ALLOCATIONS
+    world->stats.narrowphase_allocations = (int)(physics_allocation_count.load() - allocations);
+#endif
+}
+
+//NOTE: Paths the cpu can't run fall back to the widest one it can
+void set_integrator_path(PhysicsWorld* world, IntegratorPath path)
+{
+    world->integrator = (IntegratorPath)min((int)path, (int)get_supported_integrator_path());
+}
+
+void set_solver_iterations(PhysicsWorld* world, int velocity_iterations, int position_iterations)
+{
+    world->solver.velocity_iterations = velocity_iterations;
+    world->solver.position_iterations = position_iterations;
+}
+
+//NOTE: 0 substeps goes back to the rigid solver with baumgarte / position iterations
+void set_solver_substeps(PhysicsWorld* world, int substeps, float contact_hertz, float contact_damping_ratio)
+{
+    world->solver.substeps = substeps;
+    world->solver.contact_hertz = contact_hertz;
+    world->solver.contact_damping_ratio = contact_damping_ratio;
+}
+
+//NOTE: The soft step warm starts every substep and solves its normals one by one
+void prepare_manifold(BodyStore* store, Manifold* m, float dt, bool use_baumgarte, bool soft)
+{
+    for(int j = 0; j < m->contact_count; ++j)
+    {
+        Contact* c = &m->contacts[j];
+        if(!physics_warm_starting)
+        {
+            c->sum_impulse_contact = 0;
+            c->sum_impulse_friction = V3();
+        }
+
+        prepare_contact(store, m, c, dt, use_baumgarte);
+
+        if(physics_warm_starting && !soft)
+        {
+            warm_start_contact(store, m, c);
+        }
+    }
+
+    m->block_solve = false;
+    if(physics_block_solving && !soft)
+    {
+        prepare_contact_block(store, m);
+    }
+}
+
+void solve_manifold(BodyStore* store, Manifold* m)
+{
+    if(m->block_solve)
+    {
+        solve_contact_friction(store, m, &m->contacts[0]);
+        solve_contact_friction(store, m, &m->contacts[1]);
+        solve_contact_block(store, m);
+        return;
+    }
+
+    for(int j = 0; j < m->contact_count; ++j)
+    {
+        solve_contact_constraint(store, m, &m->contacts[j]);
+    }
+}
+
+void solve_joints(PhysicsWorld* world, float dt)
+{
+    BodyStore* store = &world->store;
+    for(Constraint& c : world->constraints)
+    {
+        int body_a;
+        int body_b;
+        get_constraint_bodies(&c, &body_a, &body_b);
+        if(body_a >= 0 && !is_active(store, body_a) && !is_active(store, body_b)) continue;
+
+        apply_impulse(store, &c, dt);
+    }
+}
+
+/*  NOTE: Greedy in manifold order, a manifold takes the lowest color neither of its dynamic
+    bodies has yet. Static bodies (inverse_mass == 0) are never written by the solver, any
+    number of manifolds in one color can share them. Sleeping bodies touching an awake one
+    still take impulses, so they are colored like any other dynamic body.
+*/
+void color_contacts(PhysicsWorld* world)
+{
+    BodyStore* store = &world->store;
+    int manifold_count = (int)world->manifolds.size();
+
+    world->body_colors.assign(store->count, 0);
+    world->manifold_colors.resize(manifold_count);
+    world->color_manifolds.resize(manifold_count);
+    world->color_starts.assign(SOLVER_MAX_COLORS + 2, 0);
+
+    u64* body_colors = world->body_colors.data();
+    int* color_starts = world->color_starts.data();
+    for(int i = 0; i < manifold_count; ++i)
+    {
+        Manifold* m = &world->manifolds[i];
+        if(!is_active(store, m->index_a) && !is_active(store, m->index_b))
+        {
+            world->manifold_colors[i] = SOLVER_NO_COLOR;
+            continue;
+        }
+
+        bool dynamic_a = store->inverse_mass[m->index_a] != 0;
+        bool dynamic_b = store->inverse_mass[m->index_b] != 0;
+        u64 used = (dynamic_a ? body_colors[m->index_a] : 0) | (dynamic_b ? body_colors[m->index_b] : 0);
+
+        int color = 0;
+        while(color < SOLVER_MAX_COLORS && (used & ((u64)1 << color)))
+        {
+            ++color;
+        }
+
+        if(color < SOLVER_MAX_COLORS)
+        {
+            if(dynamic_a) body_colors[m->index_a] |= (u64)1 << color;
+            if(dynamic_b) body_colors[m->index_b] |= (u64)1 << color;
+        }
+
+        world->manifold_colors[i] = (u8)color;
+        ++color_starts[color + 1];
+    }
+
+    world->stats.contact_colors = 0;
+    for(int color = 0; color <= SOLVER_MAX_COLORS; ++color)
+    {
+        if(color_starts[color + 1] > 0) ++world->stats.contact_colors;
+        color_starts[color + 1] += color_starts[color];
+    }
+
+#ifndef PHYSICS_3D
+    //NOTE: Every color starts on a fresh block of contact rows
+    world->color_row_starts.resize(SOLVER_MAX_COLORS + 1);
+    world->color_row_starts[0] = 0;
+    for(int color = 0; color < SOLVER_MAX_COLORS; ++color)
+    {
+        int count = color_starts[color + 1] - color_starts[color];
+        world->color_row_starts[color + 1] = world->color_row_starts[color] + (count + CONTACT_ROW_LANES - 1) / CONTACT_ROW_LANES * CONTACT_ROW_LANES;
+    }
+    world->contact_rows.resize(world->color_row_starts[SOLVER_MAX_COLORS] / CONTACT_ROW_LANES);
+#endif
+
+    //NOTE: Each color keeps manifold order, the solve inside a color is the serial one's
+    int cursor[SOLVER_MAX_COLORS + 1];
+    memcpy(cursor, color_starts, sizeof(cursor));
+    for(int i = 0; i < manifold_count; ++i)
+    {
+        u8 color = world->manifold_colors[i];
+        if(color != SOLVER_NO_COLOR)
+        {
+            world->color_manifolds[cursor[color]++] = i;
+        }
+    }
+}
+
+enum ContactPass
+{
+    CONTACT_PASS_PREPARE,
+    CONTACT_PASS_SOLVE,
+    //NOTE: Copies the accumulated impulses out of the contact rows
+    CONTACT_PASS_STORE,
+
+    //NOTE: Soft step only
+    CONTACT_PASS_WARM_START,
+    CONTACT_PASS_SOFT_BIAS,
+    CONTACT_PASS_RESTITUTION,
+};
+
+//NOTE: What every pass of one solve_contacts or solve_substeps shares
+struct ContactSolve
+{
+    float dt;
+    bool use_baumgarte;
+    bool use_rows;
+
+    //NOTE: Soft step, h is the substep. The soft bias pass pushes penetration out with
+    //      use_bias and only relaxes without it
+    bool soft;
+    SoftContact soft_contact;
+    float inverse_h;
+    bool use_bias;
+};
+
+struct ContactPassJob
+{
+    PhysicsWorld* world;
+    ContactPass pass;
+    ContactSolve* solve;
+
+    //NOTE: Manifolds of the color in color_manifolds, with rows the color's lanes start at
+    //      row_first and lane_count is count padded to whole blocks
+    bool use_rows;
+    int first;
+    int count;
+    int row_first;
+    int lane_count;
+    int batch_size;
+};
+
+void update_soft_manifold(BodyStore* store, Manifold* m, ContactSolve* solve)
+{
+    for(int j = 0; j < m->contact_count; ++j)
+    {
+        update_soft_contact(store, m, &m->contacts[j], solve->soft_contact, solve->inverse_h, solve->use_bias);
+    }
+}
+
+void run_contact_pass_batch(ContactPassJob* job, int batch)
+{
+    PhysicsWorld* world = job->world;
+    BodyStore* store = &world->store;
+    ContactSolve* solve = job->solve;
+    int first = batch * job->batch_size;
+    int last = min(first + job->batch_size, job->lane_count);
+
+#ifndef PHYSICS_3D
+    if(job->use_rows)
+    {
+        ContactRowBlock* blocks = world->contact_rows.data();
+        if(job->pass == CONTACT_PASS_SOLVE)
+        {
+            ContactRowBlock* first_block = &blocks[(job->row_first + first) / CONTACT_ROW_LANES];
+            solve_contact_rows(store, first_block, (last - first) / CONTACT_ROW_LANES, world->integrator);
+            return;
+        }
+
+        for(int i = first; i < last; ++i)
+        {
+            ContactRowBlock* block = &blocks[(job->row_first + i) / CONTACT_ROW_LANES];
+            int lane = (job->row_first + i) % CONTACT_ROW_LANES;
+            if(i >= job->count)
+            {
+                if(job->pass == CONTACT_PASS_PREPARE) clear_contact_lane(block, lane);
+                continue;
+            }
+
+            int index = world->color_manifolds[job->first + i];
+            Manifold* m = &world->manifolds[index];
+            switch(job->pass)
+            {
+                case CONTACT_PASS_PREPARE:
+                {
+                    prepare_manifold(store, m, solve->dt, solve->use_baumgarte, solve->soft);
+                    set_contact_lane(block, lane, store, m, index);
+                } break;
+                case CONTACT_PASS_STORE:
+                {
+                    store_contact_lane(block, lane, m);
+                } break;
+                case CONTACT_PASS_WARM_START:
+                {
+                    warm_start_contact_lane(store, block, lane);
+                } break;
+                case CONTACT_PASS_SOFT_BIAS:
+                {
+                    update_soft_manifold(store, m, solve);
+                    update_contact_lane_bias(block, lane, m);
+                } break;
+                default: break;
+            }
+        }
+        return;
+    }
+#endif
+
+    for(int i = first; i < last; ++i)
+    {
+        Manifold* m = &world->manifolds[world->color_manifolds[job->first + i]];
+        switch(job->pass)
+        {
+            case CONTACT_PASS_PREPARE:
+            {
+                prepare_manifold(store, m, solve->dt, solve->use_baumgarte, solve->soft);
+            } break;
+            case CONTACT_PASS_SOLVE:
+            {
+                solve_manifold(store, m);
+            } break;
+            case CONTACT_PASS_WARM_START:
+            {
+                for(int j = 0; j < m->contact_count; ++j)
+                {
+                    warm_start_contact(store, m, &m->contacts[j]);
+                }
+            } break;
+            case CONTACT_PASS_SOFT_BIAS:
+            {
+                update_soft_manifold(store, m, solve);
+            } break;
+            case CONTACT_PASS_RESTITUTION:
+            {
+                for(int j = 0; j < m->contact_count; ++j)
+                {
+                    solve_contact_restitution(store, m, &m->contacts[j]);
+                }
+            } break;
+            default: break;
+        }
+    }
+}
+
+//NOTE: Colors run in order with a join between them, the batches of one color touch
+//      disjoint bodies and may run on any thread
+void run_contact_pass(PhysicsWorld* world, ContactPass pass, ContactSolve* solve)
+{
+    ContactPassJob job = {};
+    job.world = world;
+    job.pass = pass;
+    job.solve = solve;
+    for(int color = 0; color <= SOLVER_MAX_COLORS; ++color)
+    {
+        job.first = world->color_starts[color];
+        job.count = world->color_starts[color + 1] - job.first;
+        if(job.count == 0) continue;
+
+        //NOTE: The leftover group may share bodies, it stays one job and never goes in rows.
+        //      Restitution runs after the rows are stored and reads the manifolds
+        job.use_rows = solve->use_rows && color < SOLVER_MAX_COLORS && pass != CONTACT_PASS_RESTITUTION;
+        if(pass == CONTACT_PASS_STORE && !job.use_rows) continue;
+
+#ifndef PHYSICS_3D
+        job.row_first = job.use_rows ? world->color_row_starts[color] : 0;
+        job.lane_count = job.use_rows ? (job.count + CONTACT_ROW_LANES - 1) / CONTACT_ROW_LANES * CONTACT_ROW_LANES : job.count;
+#else
+        job.lane_count = job.count;
+#endif
+        job.batch_size = color == SOLVER_MAX_COLORS ? job.lane_count : SOLVER_COLOR_BATCH;
+        int batch_count = (job.lane_count + job.batch_size - 1) / job.batch_size;
+        parallel_for(&world->pool, batch_count, [&job](int batch)
+        {
+            run_contact_pass_batch(&job, batch);
+        });
+    }
+}
+
+//NOTE: Sequential impulses, runs between integrate_for_velocity and integrate_for_position.
+//      With worker threads or a SIMD integrator path the manifolds are solved color by
+//      color, see color_contacts, in 2D the SIMD paths go through the contact rows of
+//      simd_contact.h. Joints are few and always run on the calling thread after the contacts
+void solve_contacts(PhysicsWorld* world, float dt)
+{
+    BodyStore* store = &world->store;
+    bool use_baumgarte = world->solver.position_iterations == 0;
+
+    ContactSolve solve = {};
+    solve.dt = dt;
+    solve.use_baumgarte = use_baumgarte;
+#ifndef PHYSICS_3D
+    solve.use_rows = world->integrator != IntegratorPath::INTEGRATOR_SCALAR;
+#endif
+
+    if(solve.use_rows || get_thread_count(&world->pool) > 1)
+    {
+        color_contacts(world);
+        run_contact_pass(world, CONTACT_PASS_PREPARE, &solve);
+        for(int i = 0; i < world->solver.velocity_iterations; ++i)
+        {
+            run_contact_pass(world, CONTACT_PASS_SOLVE, &solve);
+            solve_joints(world, dt);
+        }
+        run_contact_pass(world, CONTACT_PASS_STORE, &solve);
+        return;
+    }
+
+    world->stats.contact_colors = 0;
+    for(Manifold& m : world->manifolds)
+    {
+        if(!is_active(store, m.index_a) && !is_active(store, m.index_b)) continue;
+
+        prepare_manifold(store, &m, dt, use_baumgarte, false);
+    }
+
+    for(int i = 0; i < world->solver.velocity_iterations; ++i)
+    {
+        for(Manifold& m : world->manifolds)
+        {
+            if(!is_active(store, m.index_a) && !is_active(store, m.index_b)) continue;
+
+            solve_manifold(store, &m);
+        }
+
+        solve_joints(world, dt);
+    }
+}
+
+/*  NOTE: Soft step
+    Replaces integrate_for_velocity, solve_contacts, integrate_for_position and
+    solve_positions with solver.substeps substeps against the manifolds find_collisions
+    made for the whole step. Every substep integrates velocities, warm starts, solves the
+    contacts as soft constraints (see make_soft_contact), integrates positions and then
+    relaxes: one more solve without the spring so the velocity it added to push bodies
+    apart doesn't carry into the next substep. Restitution is applied once at the end.
+    Contacts always go through the colors, single threaded the batches just run in order.
+    Joints are solved once per substep with the substep length.
+*/
+void solve_substeps(PhysicsWorld* world, float dt)
+{
+    int substeps = max(world->solver.substeps, 1);
+    float h = dt / substeps;
+
+    ContactSolve solve = {};
+    solve.dt = dt;
+    solve.soft = true;
+    solve.inverse_h = 1.0f / h;
+#ifndef PHYSICS_3D
+    solve.use_rows = world->integrator != IntegratorPath::INTEGRATOR_SCALAR;
+#endif
+
+    //NOTE: A spring stiffer than a quarter of the substep rate isn't resolved by the substeps
+    float hertz = min(world->solver.contact_hertz, 0.25f * solve.inverse_h);
+    solve.soft_contact = make_soft_contact(hertz, world->solver.contact_damping_ratio, h);
+
+    color_contacts(world);
+    run_contact_pass(world, CONTACT_PASS_PREPARE, &solve);
+
+    //NOTE: The damping factor is meant per step, every substep takes its share of it
+    float damping = powf(physics_damping_factor, 1.0f / substeps);
+
+    for(int i = 0; i < substeps; ++i)
+    {
+        integrate_velocity(&world->store, world->integrator, h, damping);
+        if(physics_warm_starting)
+        {
+            run_contact_pass(world, CONTACT_PASS_WARM_START, &solve);
+        }
+
+        solve.use_bias = true;
+        run_contact_pass(world, CONTACT_PASS_SOFT_BIAS, &solve);
+        run_contact_pass(world, CONTACT_PASS_SOLVE, &solve);
+        solve_joints(world, h);
+
+        integrate_position(&world->store, world->integrator, h);
+
+        solve.use_bias = false;
+        run_contact_pass(world, CONTACT_PASS_SOFT_BIAS, &solve);
+        run_contact_pass(world, CONTACT_PASS_SOLVE, &solve);
+    }
+
+    run_contact_pass(world, CONTACT_PASS_STORE, &solve);
+    run_contact_pass(world, CONTACT_PASS_RESTITUTION, &solve);
+    update_body_shapes(world, dt);
+}
+
+//NOTE: Runs after integrate_for_position, stops early once nothing is deeper than the slop
+void solve_positions(PhysicsWorld* world)
+{
+    if(world->solver.position_iterations == 0) return;
+
+    BodyStore* store = &world->store;
+    for(int i = 0; i < world->solver.position_iterations; ++i)
+    {
+        float max_penetration = 0;
+        for(Manifold& m : world->manifolds)
+        {
+            if(!is_active(store, m.index_a) && !is_active(store, m.index_b)) continue;
+
+            for(int j = 0; j < m.contact_count; ++j)
+            {
+                Contact& c = m.contacts[j];
+                max_penetration = max(max_penetration, solve_contact_position(store, &m, &c));
+            }
+        }
+
+        if(max_penetration < CONTACT_PENETRATION_SLOP * 1.5f) break;
+    }
+
+    for(int i = 0; i < store->count; ++i)
+    {
+        if(is_active(store, i))
+        {
+            update_shape(&world->bodies[i].shape, store->position[i], store->orientation[i]);
+        }
+    }
+}
+
+int find_island(std::vector<int>* parent, int i)
+{
+    while((*parent)[i] != i)
+    {
+        (*parent)[i] = (*parent)[(*parent)[i]];
+        i = (*parent)[i];
+    }
+    return i;
+}
+
+void union_islands(std::vector<int>* parent, int a, int b)
+{
+    a = find_island(parent, a);
+    b = find_island(parent, b);
+    if(a != b)
+    {
+        (*parent)[max(a, b)] = min(a, b);
+    }
+}
+
+/*  NOTE: Islands are the connected components of dynamic bodies linked by touching
+    contacts or constraints, static bodies don't link anything. An island sleeps
+    when every body in it has been slow for TIME_TO_SLEEP, otherwise all of it is
+    kept awake, which is also how a sleeping pile gets woken by one touched box.
+*/
+void update_sleep(PhysicsWorld* world, float dt)
+{
+    BodyStore* store = &world->store;
+    int body_count = store->count;
+    world->stats.sleeping_bodies = 0;
+
+    if(!physics_allow_sleeping)
+    {
+        for(int i = 0; i < body_count; ++i)
+        {
+            if(is_sleeping(store, i)) wake_body(store, i);
+        }
+        return;
+    }
+
+    for(int i = 0; i < body_count; ++i)
+    {
+        if(store->inverse_mass[i] == 0 || is_sleeping(store, i)) continue;
+
+        if(length(store->velocity[i]) > SLEEP_LINEAR_TOLERANCE ||
+           angular_speed(store->angular_velocity[i]) > SLEEP_ANGULAR_TOLERANCE)
+        {
+            store->sleep_time[i] = 0;
+        }
+        else
+        {
+            store->sleep_time[i] += dt;
+        }
+    }
+
+    std::vector<int>* parent = &world->island_parent;
+    parent->resize(body_count);
+    for(int i = 0; i < body_count; ++i)
+    {
+        (*parent)[i] = i;
+    }
+
+    for(Manifold& m : world->manifolds)
+    {
+        if(m.contact_count == 0) continue;
+        if(store->inverse_mass[m.index_a] == 0 || store->inverse_mass[m.index_b] == 0) continue;
+        union_islands(parent, m.index_a, m.index_b);
+    }
+
+    for(Constraint& c : world->constraints)
+    {
+        int body_a;
+        int body_b;
+        get_constraint_bodies(&c, &body_a, &body_b);
+        if(body_a < 0 || body_b < 0) continue;
+        if(store->inverse_mass[body_a] == 0 || store->inverse_mass[body_b] == 0) continue;
+        union_islands(parent, body_a, body_b);
+    }
+
+    //NOTE: Island min sleep time is stored on its root
+    std::vector<float>& island_sleep_time = world->island_sleep_time;
+    island_sleep_time.assign(body_count, FLT_MAX);
+    for(int i = 0; i < body_count; ++i)
+    {
+        if(store->inverse_mass[i] == 0) continue;
+
+        int root = find_island(parent, i);
+        float sleep_time = is_sleeping(store, i) ? FLT_MAX : store->sleep_time[i];
+        island_sleep_time[root] = min(island_sleep_time[root], sleep_time);
+    }
+
+    for(int i = 0; i < body_count; ++i)
+    {
+        if(store->inverse_mass[i] == 0) continue;
+
+        float island_time = island_sleep_time[find_island(parent, i)];
+        if(island_time >= TIME_TO_SLEEP)
+        {
+            if(!is_sleeping(store, i))
+            {
+                store->flags[i] |= BODY_SLEEPING;
+                store->velocity[i] = V3();
+                store->angular_velocity[i] = {};
+            }
+            ++world->stats.sleeping_bodies;
+        }
+        else if(is_sleeping(store, i))
+        {
+            wake_body(store, i);
+        }
+    }
+}
+
+//NOTE: One fixed step of the world. Contacts are always found for the transforms the step
+//      starts from, a frame that runs several steps tests (or refreshes) them every step
+void step_physics_world(PhysicsWorld* world, float dt)
+{
+    find_collisions(world);
+
+    if(world->solver.substeps > 0)
+    {
+        solve_substeps(world, dt);
+    }
+    else
+    {
+        integrate_for_velocity(world, dt);
+        solve_contacts(world, dt);
+        integrate_for_position(world, dt);
+        solve_positions(world);
+    }
+
+    update_sleep(world, dt);
+}
+
+void solve_distance_constraint(BodyStore* store, DistanceConstraint* c, float dt)
 {
 /*NOTE: 
     Generalized velocity constraint is JV + b = 0
@@ -82,56 +1372,56 @@ void solve_distance_constraint(DistanceConstraint* c, float dt)
     J = [-d -(r1 x d) d (r2 x d)]
     V = [v1 w1 v2 w2]
 */
-    RigidBody* body_a = c->body_a;
-    RigidBody* body_b = c->body_b;
+    int a = c->body_a;
+    int b = c->body_b;
 
-    Vector3 r1 = to_mat3(body_a->orientation) * c->rel_pos_a;
-    Vector3 r2 = to_mat3(body_b->orientation) * c->rel_pos_b;
+    Vector3 r1 = rotate_to_local(store->orientation[a], c->rel_pos_a);
+    Vector3 r2 = rotate_to_local(store->orientation[b], c->rel_pos_b);
 
-    Vector3 global_a = r1 + body_a->position;
-    Vector3 global_b = r2 + body_b->position;
+    Vector3 global_a = r1 + store->position[a];
+    Vector3 global_b = r2 + store->position[b];
 
     Vector3 ab = global_b - global_a;
     Vector3 n = normalize(ab);
 
-    Vector3 vel_a = body_a->velocity + cross(body_a->angular_velocity, r1);
-    Vector3 vel_b = body_b->velocity + cross(body_b->angular_velocity, r2);
+    Vector3 vel_a = store->velocity[a] + cross(store->angular_velocity[a], r1);
+    Vector3 vel_b = store->velocity[b] + cross(store->angular_velocity[b], r2);
 
     float rel_vel = dot(vel_a - vel_b, n); 
 
-    float inverse_constraint_mass = body_a->inverse_mass + body_b->inverse_mass;
+    float inverse_constraint_mass = store->inverse_mass[a] + store->inverse_mass[b];
     float inverse_constraint_inertia = dot(n, 
-    cross(body_a->inverse_inertia * cross(r1, n), r1) + 
-    cross(body_b->inverse_inertia * cross(r2, n), r2));
+    cross(store->inverse_inertia[a] * cross_angular(r1, n), r1) + 
+    cross(store->inverse_inertia[b] * cross_angular(r2, n), r2));
 
     float constraint_mass = inverse_constraint_mass + inverse_constraint_inertia;
 
     if(constraint_mass > 0)
     {
-        float b = 0.0f;
+        float bias = 0.0f;
         float distance_offset = length(ab) - c->target_length;
         float baumgarte_scalar = 0.1f;
-        b = -(baumgarte_scalar / dt) * distance_offset;
+        bias = -(baumgarte_scalar / dt) * distance_offset;
 
-        float jn = -(rel_vel + b) / constraint_mass;
+        float jn = -(rel_vel + bias) / constraint_mass;
 
-        body_a->velocity += n * (body_a->inverse_mass * jn);
-        body_b->velocity -= n * (body_b->inverse_mass * jn);
+        store->velocity[a] += n * (store->inverse_mass[a] * jn);
+        store->velocity[b] -= n * (store->inverse_mass[b] * jn);
         
-        if(!body_a->freeze_orientation)
-            body_a->angular_velocity += (body_a->inverse_inertia * cross(r1, n * jn));
-        if(!body_b->freeze_orientation)
-            body_b->angular_velocity += (body_b->inverse_inertia * cross(r2, n * jn));
+        if(!(store->flags[a] & BODY_FREEZE_ORIENTATION))
+            store->angular_velocity[a] += (store->inverse_inertia[a] * cross_angular(r1, n * jn));
+        if(!(store->flags[b] & BODY_FREEZE_ORIENTATION))
+            store->angular_velocity[b] += (store->inverse_inertia[b] * cross_angular(r2, n * jn));
     }
 }
 
-void apply_impulse(Constraint* c, float dt)
+void apply_impulse(BodyStore* store, Constraint* c, float dt)
 {
     switch(c->type)
     {
         case ConstraintType::DISTANCE:
         {
-            solve_distance_constraint((DistanceConstraint*)c->constraint, dt);
+            solve_distance_constraint(store, (DistanceConstraint*)c->constraint, dt);
         } break;
     }
 }
@@ -1,6 +1,7 @@
 #ifndef PHYSICS_H
 #define PHYSICS_H
 
+#include <vector>
 #include "../math.h"
 #include "../shape.h"
 
@@ -10,6 +11,22 @@ static float physics_dt = 1.0f / 120.0f;
 
 static Vector3 physics_gravity = {0, -98, 0};
 static float physics_damping_factor = 0.95f;
+static bool physics_warm_starting = true;
+//NOTE: Two contact manifolds get the exact solution of their normals instead of one
+//      contact after the other, see prepare_contact_block. set_block_solving(false)
+//      goes back to the sequential contacts
+static bool physics_block_solving = true;
+//NOTE: Off by default, resting pairs keep last step's contacts moved along with their
+//      bodies instead of being tested again. tests/check_contact_refresh.cpp steps the
+//      same stacks both ways and compares them
+static bool physics_contact_refresh = false;
+static bool physics_allow_sleeping = true;
+
+//NOTE: A body is a sleep candidate while it moves slower than these, a whole island goes
+//      to sleep once all of its bodies have been candidates for TIME_TO_SLEEP seconds
+#define SLEEP_LINEAR_TOLERANCE 1.0f
+#define SLEEP_ANGULAR_TOLERANCE 0.035f
+#define TIME_TO_SLEEP 0.5f
 
 enum DebugType
 {
@@ -17,6 +34,10 @@ enum DebugType
     PLAYER,
 };
 
+//NOTE: Describes a body to add_body. Afterwards the world's BodyStore owns position, velocity,
+//      orientation, angular velocity, force, torque, mass and inertia, the copies left
+//      in world->bodies are the values the body was added with, read the live ones
+//      through the get_body_ / set_body_ accessors
 struct RigidBody
 {
     Shape shape;
@@ -27,33 +48,244 @@ struct RigidBody
     
     float inverse_mass;
     
-    Quaternion orientation;
-    Vector3 angular_velocity;
-    Vector3 torgue;
-    Mat3 inverse_inertia;
+    Rotation orientation;
+    Angular angular_velocity;
+    Angular torgue;
+    InverseInertia inverse_inertia;
 
     float restitution;
     float friction; 
 
     bool freeze_orientation;
 
+    //NOTE: Leaf of this body in the world's AABB tree or its box index in sweep and prune / grid
+    int proxy;
+
     //Debug purpose
     Vector4 color;
     DebugType type;
 };
 
+#include "body_store.h"
+#include "simd_integrate.h"
 #include "manifold.h"
+#ifndef PHYSICS_3D
+#include "simd_contact.h"
+#endif
 #include "constraints.h"
-#include "sat.h"
+#include "narrowphase.h"
 #include "gjk.h"
+#include "broadphase.h"
+#include "sap.h"
+#include "grid.h"
+#include "thread_pool.h"
+
+/*  NOTE: Allocation counter
+    Define PHYSICS_COUNT_ALLOCATIONS (once per program, it replaces the global operator new)
+    to count every heap allocation, the narrowphase reports its share in PhysicsStats.
+    Meant for benchmarks checking that the step runs without touching the heap.
+*/
+#ifdef PHYSICS_COUNT_ALLOCATIONS
+#include <atomic>
+#include <new>
+
+std::atomic<u64> physics_allocation_count;
+
+void* operator new(size_t size)
+{
+    ++physics_allocation_count;
+    void* p = malloc(size ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+#endif
+
+//NOTE: Pair generation is split into this many slices per thread so uneven slices balance out
+#define BROADPHASE_SLICES_PER_THREAD 4
+
+enum BroadphaseType
+{
+    AABB_TREE,
+    SWEEP_AND_PRUNE,
+    UNIFORM_GRID,
+};
+
+#define SOLVER_DEFAULT_VELOCITY_ITERATIONS 8
+#define SOLVER_DEFAULT_POSITION_ITERATIONS 3
+
+/*  NOTE: Contact coloring
+    With worker threads or a SIMD integrator path the manifolds are colored so no two of
+    one color share a dynamic body, a color is then solved in parallel batches (in 2D
+    through the contact rows) and the colors one after another.
+    Bodies run out of colors only in very dense piles, the manifolds left over go in
+    one extra group that is solved on the calling thread.
+*/
+#define SOLVER_MAX_COLORS 64
+//NOTE: Manifolds per parallel job, a whole number of contact row blocks
+#define SOLVER_COLOR_BATCH 128
+#define SOLVER_NO_COLOR 0xFF
+
+#define SOLVER_DEFAULT_SUBSTEPS 4
+#define SOLVER_DEFAULT_CONTACT_HERTZ 30.0f
+#define SOLVER_DEFAULT_CONTACT_DAMPING_RATIO 10.0f
+
+//NOTE: Without position iterations penetration is fixed with a baumgarte term in the velocity solve.
+//      With substeps the step goes through solve_substeps instead and the contacts are soft
+//      springs of contact_hertz and contact_damping_ratio, the iteration counts are unused
+struct SolverSettings
+{
+    int velocity_iterations;
+    int position_iterations;
+
+    int substeps;
+    float contact_hertz;
+    float contact_damping_ratio;
+};
+
+struct PhysicsStats
+{
+    int broadphase_pairs;
+    //NOTE: Broadphase pairs whose bounding circles or exact AABBs don't touch, never tested
+    int bounds_rejected;
+    int pair_tests;
+    //NOTE: Axes projected by the SAT kernels, the batched box path counts the ones
+    //      test_box_box would project for the same pairs
+    int sat_axes_tested;
+    //NOTE: Box pairs the batched axis tests dropped before any clipping
+    int box_box_separated;
+    //NOTE: Pairs whose manifold was moved along from last frame instead of tested
+    int contact_refreshes;
+    int manifolds;
+    //NOTE: Colors the last solve_contacts used, 0 when it ran serially
+    int contact_colors;
+    int sleeping_bodies;
+
+    //NOTE: Heap allocations made by the last find_collisions after the broadphase,
+    //      only filled in with PHYSICS_COUNT_ALLOCATIONS
+    int narrowphase_allocations;
+};
+
+struct PhysicsWorld
+{
+    //NOTE: Cold data per body, the hot state is in store under the same index
+    std::vector<RigidBody> bodies;
+    BodyStore store;
+
+    //NOTE: World space vertices and edge normals of every body's shape, rewritten by
+    //      update_shape whenever the body moves
+    std::vector<Vector3> shape_vertices;
+    std::vector<Vector3> shape_normals;
+
+    //NOTE: Manifolds persist across frames, old_manifolds keeps last frame's set around for
+    //      contact matching. They are stored grouped by narrowphase routine, manifold_order
+    //      lists them sorted by Manifold::key
+    std::vector<Manifold> manifolds;
+    std::vector<Manifold> old_manifolds;
+    std::vector<ManifoldRef> manifold_order;
+    std::vector<ManifoldRef> old_manifold_order;
+
+    //NOTE: Narrowphase scratch, per pair its table entry and manifold (-1 without contact),
+    //      and the pairs grouped by table entry
+    std::vector<u8> pair_kernels;
+    std::vector<int> pair_manifolds;
+    std::vector<int> pair_batches;
+    std::vector<int> pair_sat_axes;
+    std::vector<GjkCache> pair_gjk_caches;
+
+    //NOTE: Deciding SAT axis of every pair tested last step, touching or not, in key order
+    std::vector<SatAxisRef> sat_axes;
+    std::vector<SatAxisRef> old_sat_axes;
+
+    //NOTE: Last simplex of every pair test_gjk ran on last step, in key order
+    std::vector<GjkCacheRef> gjk_caches;
+    std::vector<GjkCacheRef> old_gjk_caches;
+
+    std::vector<Constraint> constraints;
+
+    //NOTE: Colors given out per body as a bit mask, manifold indices grouped by color,
+    //      color i is color_manifolds[color_starts[i]] up to color_starts[i + 1]
+    std::vector<u64> body_colors;
+    std::vector<u8> manifold_colors;
+    std::vector<int> color_manifolds;
+    std::vector<int> color_starts;
+#ifndef PHYSICS_3D
+    //NOTE: Prepared contacts of every color but the leftover group, see simd_contact.h
+    std::vector<ContactRowBlock> contact_rows;
+    std::vector<int> color_row_starts;
+#endif
+
+    //NOTE: Union-find parents, rebuilt every step by update_sleep
+    std::vector<int> island_parent;
+    std::vector<float> island_sleep_time;
+
+    BroadphaseType broadphase;
+    AABBTree tree;
+    SweepAndPrune sap;
+    UniformGrid grid;
+    std::vector<BroadphasePair> pairs;
+
+    //NOTE: Per slice output of the parallel pair generation, merged in slice order
+    ThreadPool pool;
+    std::vector<std::vector<BroadphasePair>> slice_pairs;
+
+    SolverSettings solver;
+    IntegratorPath integrator;
+    PhysicsStats stats;
+};
 
 RigidBody create_body(Shape shape, Vector3 p, Vector3 v, float mass);
 
+void init_physics_world(PhysicsWorld* world, BroadphaseType broadphase = BroadphaseType::AABB_TREE);
+void destroy_physics_world(PhysicsWorld* world);
+void set_worker_threads(PhysicsWorld* world, int worker_count);
+int add_body(PhysicsWorld* world, RigidBody body);
+void add_constraint(PhysicsWorld* world, Constraint c);
+void update_pairs(PhysicsWorld* world);
+void find_collisions(PhysicsWorld* world);
+void set_integrator_path(PhysicsWorld* world, IntegratorPath path);
+void set_solver_iterations(PhysicsWorld* world, int velocity_iterations, int position_iterations);
+void set_solver_substeps(PhysicsWorld* world, int substeps, float contact_hertz = SOLVER_DEFAULT_CONTACT_HERTZ,
+                         float contact_damping_ratio = SOLVER_DEFAULT_CONTACT_DAMPING_RATIO);
+void solve_contacts(PhysicsWorld* world, float dt);
+void solve_substeps(PhysicsWorld* world, float dt);
+void solve_positions(PhysicsWorld* world);
+void update_sleep(PhysicsWorld* world, float dt);
+void step_physics_world(PhysicsWorld* world, float dt);
+
+Vector3 get_body_position(PhysicsWorld* world, int body);
+Rotation get_body_orientation(PhysicsWorld* world, int body);
+Vector3 get_body_velocity(PhysicsWorld* world, int body);
+Angular get_body_angular_velocity(PhysicsWorld* world, int body);
+void set_body_velocity(PhysicsWorld* world, int body, Vector3 v);
+void set_body_angular_velocity(PhysicsWorld* world, int body, Angular w);
+void set_body_force(PhysicsWorld* world, int body, Vector3 force);
+void set_body_torque(PhysicsWorld* world, int body, Angular torque);
+bool is_body_sleeping(PhysicsWorld* world, int body);
+void wake_body(PhysicsWorld* world, int body);
+
 void set_gravity(Vector3 g);
 void set_damping_factor(float k);
+void set_warm_starting(bool enabled);
+void set_block_solving(bool enabled);
+void set_contact_refresh(bool enabled);
+void set_sleeping(bool enabled);
+void set_grid_cell_size(PhysicsWorld* world, float cell_size);
 
 void integrate_for_velocity(RigidBody* body, float dt);
 void integrate_for_position(RigidBody* body, float dt);
-void apply_impulse(Constraint* c, float dt);
+void integrate_for_velocity(PhysicsWorld* world, float dt);
+void integrate_for_position(PhysicsWorld* world, float dt);
+void update_body_shapes(PhysicsWorld* world, float dt);
+void apply_impulse(BodyStore* store, Constraint* c, float dt);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,276 @@
+#ifndef SAP_H
+#define SAP_H
+
+#include <vector>
+#include "broadphase.h"
+
+/*  NOTE: Sweep and prune
+    Keeps the min/max endpoints of every box sorted along x and y across frames.
+    Bodies in a resting pile barely move so the arrays are almost sorted and an
+    insertion sort fixes them in close to O(n). Overlap only changes when two
+    endpoints swap, so the pairs are updated from the swaps instead of being
+    rebuilt:
+        min passes a max going left -> the boxes may start overlapping
+        max passes a min going left -> the boxes stop overlapping
+    The swaps only produce add and remove events, the caller keeps the sorted pair list
+    and merges the events into it with sap_apply_pair_events.
+    Reference: D. Baraff, "Dynamic Simulation of Non-Penetrating Rigid Bodies", 1992
+*/
+
+//NOTE: If more than this fraction of the boxes are new the arrays are rebuilt with a
+//      full sort, insertion sort is quadratic on unsorted input
+#define SAP_REBUILD_RATIO 0.25f
+
+struct SAPEndpoint
+{
+    float value;
+    //NOTE: box index << 1 | 1 if this is a max endpoint
+    u32 data;
+};
+
+struct SweepAndPrune
+{
+    std::vector<AABB> boxes;
+    std::vector<SAPEndpoint> endpoints[2];
+    int new_count;
+
+    //NOTE: Events from the last sap_update. A pair may show up twice (once per axis) and
+    //      a remove may name a pair that wasn't overlapping. After a rebuild added_pairs
+    //      holds every overlapping pair and rebuilt is set
+    std::vector<BroadphasePair> added_pairs;
+    std::vector<BroadphasePair> removed_pairs;
+    bool rebuilt;
+
+    //NOTE: Scratch for sap_apply_pair_events, swapped with the caller's pairs every update
+    std::vector<BroadphasePair> merged_pairs;
+
+    //NOTE: Scratch for sap_rebuild, boxes whose min endpoint has been swept past
+    std::vector<int> active;
+};
+
+inline bool endpoint_is_max(SAPEndpoint e)
+{
+    return e.data & 1;
+}
+
+inline int endpoint_box(SAPEndpoint e)
+{
+    return (int)(e.data >> 1);
+}
+
+//NOTE: On equal values a min sorts before a max so touching boxes count as overlapping,
+//      same as aabb_overlap
+inline bool endpoint_less(SAPEndpoint a, SAPEndpoint b)
+{
+    return a.value < b.value || (a.value == b.value && (a.data & 1) < (b.data & 1));
+}
+
+inline float endpoint_value(AABB* box, int axis, bool is_max)
+{
+    return is_max ? box->max.E[axis] : box->min.E[axis];
+}
+
+void init_sap(SweepAndPrune* sap)
+{
+    sap->boxes.clear();
+    sap->endpoints[0].clear();
+    sap->endpoints[1].clear();
+    sap->new_count = 0;
+    sap->added_pairs.clear();
+    sap->removed_pairs.clear();
+    sap->rebuilt = false;
+    sap->merged_pairs.clear();
+}
+
+int sap_add_box(SweepAndPrune* sap, AABB box)
+{
+    int index = (int)sap->boxes.size();
+    sap->boxes.push_back(box);
+
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        SAPEndpoint e_min = {box.min.E[axis], (u32)index << 1};
+        SAPEndpoint e_max = {box.max.E[axis], ((u32)index << 1) | 1};
+        sap->endpoints[axis].push_back(e_min);
+        sap->endpoints[axis].push_back(e_max);
+    }
+    ++sap->new_count;
+
+    return index;
+}
+
+//NOTE: An add only happens when the boxes overlap with this frame's bounds and a remove
+//      only when they don't, so one update never adds and removes the same pair
+void sap_add_pair(SweepAndPrune* sap, int a, int b)
+{
+    sap->added_pairs.push_back(pair_from_key(pair_key(a, b)));
+}
+
+void sap_remove_pair(SweepAndPrune* sap, int a, int b)
+{
+    sap->removed_pairs.push_back(pair_from_key(pair_key(a, b)));
+}
+
+void sap_insertion_sort(SweepAndPrune* sap, int axis)
+{
+    std::vector<SAPEndpoint>& endpoints = sap->endpoints[axis];
+    AABB* boxes = sap->boxes.data();
+
+    for(int i = 1; i < (int)endpoints.size(); ++i)
+    {
+        SAPEndpoint e = endpoints[i];
+        int j = i - 1;
+
+        while(j >= 0 && endpoint_less(e, endpoints[j]))
+        {
+            SAPEndpoint prev = endpoints[j];
+            bool e_max = endpoint_is_max(e);
+            bool prev_max = endpoint_is_max(prev);
+
+            if(!e_max && prev_max)
+            {
+                int a = endpoint_box(e);
+                int b = endpoint_box(prev);
+                if(aabb_overlap(boxes[a], boxes[b]))
+                {
+                    sap_add_pair(sap, a, b);
+                }
+            }
+            else if(e_max && !prev_max)
+            {
+                sap_remove_pair(sap, endpoint_box(e), endpoint_box(prev));
+            }
+
+            endpoints[j + 1] = prev;
+            --j;
+        }
+
+        endpoints[j + 1] = e;
+    }
+}
+
+//NOTE: Full sort and sweep along x, used on the first update and after big batches of new boxes
+void sap_rebuild(SweepAndPrune* sap)
+{
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        std::sort(sap->endpoints[axis].begin(), sap->endpoints[axis].end(), endpoint_less);
+    }
+
+    sap->rebuilt = true;
+
+    std::vector<int>& active = sap->active;
+    active.clear();
+    for(SAPEndpoint e : sap->endpoints[0])
+    {
+        int index = endpoint_box(e);
+        if(endpoint_is_max(e))
+        {
+            for(int i = 0; i < (int)active.size(); ++i)
+            {
+                if(active[i] == index)
+                {
+                    active[i] = active.back();
+                    active.pop_back();
+                    break;
+                }
+            }
+        }
+        else
+        {
+            AABB box = sap->boxes[index];
+            for(int other : active)
+            {
+                if(aabb_overlap(box, sap->boxes[other]))
+                {
+                    sap_add_pair(sap, index, other);
+                }
+            }
+            active.push_back(index);
+        }
+    }
+}
+
+//NOTE: Boxes must already hold this frame's bounds
+void sap_update(SweepAndPrune* sap)
+{
+    sap->added_pairs.clear();
+    sap->removed_pairs.clear();
+    sap->rebuilt = false;
+
+    for(int axis = 0; axis < 2; ++axis)
+    {
+        for(SAPEndpoint& e : sap->endpoints[axis])
+        {
+            e.value = endpoint_value(&sap->boxes[endpoint_box(e)], axis, endpoint_is_max(e));
+        }
+    }
+
+    if(sap->new_count > SAP_REBUILD_RATIO * sap->boxes.size())
+    {
+        sap_rebuild(sap);
+    }
+    else
+    {
+        sap_insertion_sort(sap, 0);
+        sap_insertion_sort(sap, 1);
+    }
+
+    sap->new_count = 0;
+}
+
+void sort_unique_pairs(std::vector<BroadphasePair>* pairs)
+{
+    sort_pairs(pairs);
+    pairs->erase(std::unique(pairs->begin(), pairs->end()), pairs->end());
+}
+
+//NOTE: Merges the last sap_update's events into pairs, which stays sorted with pair_less.
+//      Only the events get sorted, the merge is one walk over the pairs
+void sap_apply_pair_events(SweepAndPrune* sap, std::vector<BroadphasePair>* pairs)
+{
+    sort_unique_pairs(&sap->added_pairs);
+    if(sap->rebuilt)
+    {
+        pairs->assign(sap->added_pairs.begin(), sap->added_pairs.end());
+        return;
+    }
+    if(sap->added_pairs.empty() && sap->removed_pairs.empty()) return;
+
+    sort_unique_pairs(&sap->removed_pairs);
+
+    BroadphasePair* added = sap->added_pairs.data();
+    BroadphasePair* removed = sap->removed_pairs.data();
+    int added_count = (int)sap->added_pairs.size();
+    int removed_count = (int)sap->removed_pairs.size();
+    int next_added = 0;
+    int next_removed = 0;
+
+    std::vector<BroadphasePair>& merged = sap->merged_pairs;
+    merged.clear();
+    merged.reserve(pairs->size() + added_count);
+    for(BroadphasePair pair : *pairs)
+    {
+        while(next_added < added_count && pair_less(added[next_added], pair))
+        {
+            merged.push_back(added[next_added++]);
+        }
+        if(next_added < added_count && added[next_added] == pair)
+        {
+            ++next_added;
+        }
+
+        while(next_removed < removed_count && pair_less(removed[next_removed], pair))
+        {
+            ++next_removed;
+        }
+        if(next_removed < removed_count && removed[next_removed] == pair) continue;
+
+        merged.push_back(pair);
+    }
+    merged.insert(merged.end(), added + next_added, added + added_count);
+
+    pairs->swap(merged);
+}
+
+#endif
@@ -9,25 +9,49 @@ struct ClippingEdge
     Vector3 v1;
     Vector3 v2;
     Vector3 max;
+    Vector3 normal;
+
+    //NOTE: Index of v1, an edge always runs from vertex index to index + 1
+    int index;
 };
 
-std::vector<Vector3> generate_test_axes(Shape* shape)
+//NOTE: Point produced by the clipping, id tells which features of the two shapes made it
+//      so the same contact can be found again next frame
+struct ClipVertex
 {
-    std::vector<Vector3> axes;
+    Vector3 v;
+    u32 id;
 
-    for(int i = 0; i < shape->vertices_count; ++i)
-    {
-        Vector3 p1 = shape->global_vertices[i];
-        Vector3 p2 = shape->global_vertices[i + 1 == shape->vertices_count ? 0 : i + 1];
+    //NOTE: How far the point is past the reference face, filled once clipping is done
+    float depth;
+};
 
-        Vector3 edge = p2 - p1;
-        Vector3 n = V3(cross(edge.xy, -1));
-        axes.push_back(normalize(n));
-    }
+enum ClipFeature
+{
+    INCIDENT_VERTEX_1,
+    INCIDENT_VERTEX_2,
+    CLIPPED_BY_SIDE_1,
+    CLIPPED_BY_SIDE_2,
+};
 
-    return axes;
+/*  NOTE: Feature id layout
+    bits  0..7  reference edge index
+    bits  8..15 incident edge index
+    bits 16..23 ClipFeature
+    bit  24     reference edge belongs to shape b
+*/
+inline u32 make_feature_id(int ref_edge, int inc_edge, ClipFeature feature, bool flip)
+{
+    return (u32)(ref_edge & 0xFF) | ((u32)(inc_edge & 0xFF) << 8) | ((u32)feature << 16) | ((u32)flip << 24);
 }
 
+//NOTE: Keeps the two clip inputs at most, so the points never need more room than this
+struct ClipPoints
+{
+    ClipVertex v[2];
+    int count;
+};
+
 Vector2 project_to_axis(Vector3 axis, Shape* shape)
 {
     float min = dot(axis, shape->global_vertices[0]);
@@ -72,13 +96,17 @@ ClippingEdge find_best_edge(Shape* shape, Vector3 n)
     Vector3 v_next = shape->global_vertices[index_next]; 
     Vector3 v_prev = shape->global_vertices[index_prev]; 
 
-    Vector3 l = normalize(v - v_next);
-    Vector3 r = normalize(v - v_prev);
+    //NOTE: Picks the edge most perpendicular to n, for unit vectors that is the one whose
+    //      normal is most parallel to n so the precomputed normals save normalizing the edges
+    Vector3 n_prev = shape->global_normals[index_prev];
+    Vector3 n_next = shape->global_normals[index];
 
-    if(dot(r, n) <= dot(l, n))
+    if(abs(dot(n_prev, n)) >= abs(dot(n_next, n)))
     {
         result.v1 = v_prev;
         result.v2 = v;
+        result.index = index_prev;
+        result.normal = n_prev;
         result.edge = result.v2 - result.v1;
         return result;
     }
@@ -86,36 +114,39 @@ ClippingEdge find_best_edge(Shape* shape, Vector3 n)
     {
         result.v1 = v;
         result.v2 = v_next;
+        result.index = index;
+        result.normal = n_next;
         result.edge = result.v2 - result.v1;
         return result;
     }
 }
 
-std::vector<Vector3> clip(Vector3 v1, Vector3 v2, Vector3 n, float o)
+//NOTE: A point created by the clip takes clip_id, kept points keep their own id
+ClipPoints clip(ClipVertex v1, ClipVertex v2, Vector3 n, float o, u32 clip_id)
 {
-    std::vector<Vector3> cp;
-    float d1 = dot(n, v1) - o;
-    float d2 = dot(n, v2) - o;
+    ClipPoints cp = {};
+    float d1 = dot(n, v1.v) - o;
+    float d2 = dot(n, v2.v) - o;
 
-    if(d1 >= 0) cp.push_back(v1);
-    if(d2 >= 0) cp.push_back(v2);
+    if(d1 >= 0) cp.v[cp.count++] = v1;
+    if(d2 >= 0) cp.v[cp.count++] = v2;
 
     if(d1 * d2 < 0)
     {
-        Vector3 e = v2 - v1;
+        Vector3 e = v2.v - v1.v;
         float u = d1 / (d1 - d2);
         e = e * u;
-        e += v1;
+        e += v1.v;
 
-        cp.push_back(e);
+        cp.v[cp.count++] = {e, clip_id, 0};
     }
 
     return cp;
 }
 
-std::vector<Vector3> generate_contact_points(Shape* shape_a, Shape* shape_b, Vector3 normal)
+ClipPoints generate_contact_points(Shape* shape_a, Shape* shape_b, Vector3 normal)
 {
-    std::vector<Vector3> cp;
+    ClipPoints cp = {};
     ClippingEdge e1 = find_best_edge(shape_a, normal);
     ClippingEdge e2 = find_best_edge(shape_b, -normal);
     
@@ -133,15 +164,19 @@ std::vector<Vector3> generate_contact_points(Shape* shape_a, Shape* shape_b, Vec
         flip = true;
     }
 
-    Vector3 refv = normalize(ref.edge);
+    //NOTE: Edge direction from its normal, the normal is the edge turned clockwise
+    Vector3 refv = V3(perp(ref.normal.xy));
+
+    ClipVertex inc_v1 = {inc.v1, make_feature_id(ref.index, inc.index, ClipFeature::INCIDENT_VERTEX_1, flip), 0};
+    ClipVertex inc_v2 = {inc.v2, make_feature_id(ref.index, inc.index, ClipFeature::INCIDENT_VERTEX_2, flip), 0};
 
     float o1 = dot(refv, ref.v1);
-    cp = clip(inc.v1, inc.v2, refv, o1);
-    if(cp.size() < 2) return {};
+    cp = clip(inc_v1, inc_v2, refv, o1, make_feature_id(ref.index, inc.index, ClipFeature::CLIPPED_BY_SIDE_1, flip));
+    if(cp.count < 2) return {};
 
     float o2 = dot(refv, ref.v2);
-    cp = clip(cp[0], cp[1], -refv, -o2);
-    if(cp.size() < 2) return {};
+    cp = clip(cp.v[0], cp.v[1], -refv, -o2, make_feature_id(ref.index, inc.index, ClipFeature::CLIPPED_BY_SIDE_2, flip));
+    if(cp.count < 2) return {};
 
     //NOTE: if we flipped we have to use the left hand orthogonal vector otherwise use right hand
     Vector3 ref_n = flip ? V3(reverse_perp(refv.xy)) : V3(perp(refv.xy));
@@ -150,83 +185,214 @@ std::vector<Vector3> generate_contact_points(Shape* shape_a, Shape* shape_b, Vec
 
     float max = dot(ref_n, ref.max);
 
-    float d0 = dot(ref_n, cp[0]);
-    float d1 = dot(ref_n, cp[1]);
+    float d0 = dot(ref_n, cp.v[0].v);
+    float d1 = dot(ref_n, cp.v[1].v);
+    cp.v[0].depth = d0 - max;
+    cp.v[1].depth = d1 - max;
 
-    if(d1 - max < 0)
+    if(cp.v[1].depth < 0)
     {
-        cp.erase(cp.begin() + 1);
+        --cp.count;
     }
-    if(d0 - max < 0)
+    if(cp.v[0].depth < 0)
     {
-        cp.erase(cp.begin());
+        cp.v[0] = cp.v[1];
+        --cp.count;
     }
 
     return cp;
 }
 
+//NOTE: Fills the manifold once the axis of least overlap is known, shared by the SAT kernels
+void set_sat_manifold(RigidBody* body_a, RigidBody* body_b, Manifold* manifold, Vector3 normal, float overlap)
+{
+    manifold->body_a = body_a;
+    manifold->body_b = body_b;
+    manifold->normal = normal;
+    manifold->depth = overlap;
+    manifold->mtv = normal * overlap;
+    ClipPoints cp = generate_contact_points(&body_a->shape, &body_b->shape, manifold->normal);
+    for(int i = 0; i < cp.count; ++i)
+    {
+        add_contact(manifold, cp.v[i].v, cp.v[i].depth, cp.v[i].id);
+    }
+}
+
+/*  NOTE: Separating axis cache
+    A pair that was apart last frame is almost always apart along the same axis this
+    frame. find_collisions passes the axis that decided last frame's result in
+    Manifold::sat_axis, the SAT kernels project that one first and stop right there if it
+    still separates. Otherwise every axis runs in the usual order, reusing the cached
+    projection, so the contact is the same as without the cache. On the way out sat_axis
+    holds the axis that separated the pair or the one of least overlap.
+*/
+#define SAT_AXIS_NONE 0
+
+//NOTE: Axis index of a shape's edge normal, owner 0 is shape a and 1 is shape b
+inline int make_sat_axis(int owner, int index)
+{
+    return 1 + owner * SHAPE_MAX_VERTICES + index;
+}
+
+inline int get_sat_axis_owner(int axis)
+{
+    return (axis - 1) / SHAPE_MAX_VERTICES;
+}
+
+inline int get_sat_axis_index(int axis)
+{
+    return (axis - 1) % SHAPE_MAX_VERTICES;
+}
+
+//NOTE: Key and deciding axis of a pair, kept in key order from one step to the next
+struct SatAxisRef
+{
+    u64 key;
+    int axis;
+};
+
 bool test_SAT(RigidBody* body_a, RigidBody* body_b, Manifold* manifold) 
 {
     Shape* shape_a = &body_a->shape; 
     Shape* shape_b = &body_b->shape;
 
-    float overlap = FLT_MAX;
-    Vector3 smallest;
-
-    std::vector<Vector3> axes_a = generate_test_axes(shape_a);
-    std::vector<Vector3> axes_b = generate_test_axes(shape_b);
-
-    for(int i = 0; i < axes_a.size(); ++i)
+    int cached = manifold->sat_axis;
+    Vector2 cached_a = {};
+    Vector2 cached_b = {};
+    if(cached != SAT_AXIS_NONE)
     {
-        Vector2 projection_a = project_to_axis(axes_a[i], shape_a);
-        Vector2 projection_b = project_to_axis(axes_a[i], shape_b);
-
-        if(!is_projected_overlap(projection_a, projection_b))
+        Shape* owner = get_sat_axis_owner(cached) ? shape_b : shape_a;
+        if(get_sat_axis_index(cached) < owner->vertices_count)
         {
-            return false;
+            Vector3 axis = owner->global_normals[get_sat_axis_index(cached)];
+            cached_a = project_to_axis(axis, shape_a);
+            cached_b = project_to_axis(axis, shape_b);
+            ++manifold->sat_axes_tested;
+            if(!is_projected_overlap(cached_a, cached_b)) return false;
         }
         else
         {
+            cached = SAT_AXIS_NONE;
+        }
+    }
+
+    float overlap = FLT_MAX;
+    Vector3 smallest;
+    int smallest_axis = SAT_AXIS_NONE;
+
+    //NOTE: update_shape keeps the edge normals current, nothing to normalize per pair
+    for(int owner = 0; owner < 2; ++owner)
+    {
+        Shape* shape = owner ? shape_b : shape_a;
+        Vector3* axes = shape->global_normals;
+        for(int i = 0; i < shape->vertices_count; ++i)
+        {
+            int id = make_sat_axis(owner, i);
+            Vector2 projection_a = cached_a;
+            Vector2 projection_b = cached_b;
+            if(id != cached)
+            {
+                projection_a = project_to_axis(axes[i], shape_a);
+                projection_b = project_to_axis(axes[i], shape_b);
+                ++manifold->sat_axes_tested;
+
+                if(!is_projected_overlap(projection_a, projection_b))
+                {
+                    manifold->sat_axis = id;
+                    return false;
+                }
+            }
+
             float o = get_overlap_from_projection(projection_a, projection_b);
             if(o < overlap)
             {
                 overlap = o;
-                smallest = projection_a.y > projection_b.y ? -axes_a[i] : axes_a[i];
+                smallest = projection_a.y > projection_b.y ? -axes[i] : axes[i];
+                smallest_axis = id;
             }
         }
     }
 
-    for(int i = 0; i < axes_b.size(); ++i)
+    manifold->sat_axis = smallest_axis;
+    set_sat_manifold(body_a, body_b, manifold, smallest, overlap);
+    return true;
+}
+
+//NOTE: A box is its center, half extents and two axes, so its projection is
+//      center . n +- the half extents along n, no loop over the vertices
+inline Vector2 project_box_to_axis(Vector3 axis, Shape* box)
+{
+    //NOTE: Normals 2 and 3 of the rectangle are its local +x and +y
+    Vector3 u = box->global_normals[2];
+    Vector3 v = box->global_normals[3];
+
+    float c = dot(axis, box->center_pos);
+    float r = 0.5f * (box->dim.x * abs(dot(u, axis)) + box->dim.y * abs(dot(v, axis)));
+    return V2(c - r, c + r);
+}
+
+/*  NOTE: Box vs box
+    Opposite edges of a box share an axis, so only 4 axes are tested instead of the 8
+    test_SAT would use, and each projection is two dot products. Axis order and the
+    overlap/normal rules are the same as test_SAT so both agree on the result. Needs the
+    2D update_shape, the PHYSICS_3D one can shear a box into a rhombus.
+*/
+bool test_box_box(RigidBody* body_a, RigidBody* body_b, Manifold* manifold)
+{
+    Shape* shape_a = &body_a->shape;
+    Shape* shape_b = &body_b->shape;
+
+    Vector3 axes[4] = {shape_a->global_normals[0], shape_a->global_normals[1],
+                       shape_b->global_normals[0], shape_b->global_normals[1]};
+    int ids[4] = {make_sat_axis(0, 0), make_sat_axis(0, 1), make_sat_axis(1, 0), make_sat_axis(1, 1)};
+
+    //NOTE: Same cache as test_SAT, a box only has axes 0 and 1 of each shape to remember
+    int cached = -1;
+    Vector2 cached_a = {};
+    Vector2 cached_b = {};
+    for(int i = 0; i < 4; ++i)
     {
-        Vector2 projection_a = project_to_axis(axes_b[i], shape_a);
-        Vector2 projection_b = project_to_axis(axes_b[i], shape_b);
+        if(ids[i] == manifold->sat_axis) cached = i;
+    }
+    if(cached >= 0)
+    {
+        cached_a = project_box_to_axis(axes[cached], shape_a);
+        cached_b = project_box_to_axis(axes[cached], shape_b);
+        ++manifold->sat_axes_tested;
+        if(!is_projected_overlap(cached_a, cached_b)) return false;
+    }
 
-        if(!is_projected_overlap(projection_a, projection_b))
-        {
-            return false;
-        }
-        else
+    float overlap = FLT_MAX;
+    Vector3 smallest;
+    int smallest_axis = SAT_AXIS_NONE;
+    for(int i = 0; i < 4; ++i)
+    {
+        Vector2 projection_a = cached_a;
+        Vector2 projection_b = cached_b;
+        if(i != cached)
         {
-            float o = get_overlap_from_projection(projection_a, projection_b);
-            if(o < overlap)
+            projection_a = project_box_to_axis(axes[i], shape_a);
+            projection_b = project_box_to_axis(axes[i], shape_b);
+            ++manifold->sat_axes_tested;
+
+            if(!is_projected_overlap(projection_a, projection_b))
             {
-                overlap = o;
-                smallest = projection_a.y > projection_b.y ? -axes_b[i] : axes_b[i];
+                manifold->sat_axis = ids[i];
+                return false;
             }
         }
-    }
 
-    manifold->body_a = body_a;
-    manifold->body_b = body_b;
-    manifold->normal = smallest;
-    manifold->depth = overlap;
-    manifold->mtv = smallest * overlap;
-    manifold->cp = generate_contact_points(shape_a, shape_b, manifold->normal);
-    for(int i = 0; i < manifold->cp.size(); ++i)
-    {
-        add_contact(manifold, manifold->cp[i]);
+        float o = get_overlap_from_projection(projection_a, projection_b);
+        if(o < overlap)
+        {
+            overlap = o;
+            smallest = projection_a.y > projection_b.y ? -axes[i] : axes[i];
+            smallest_axis = ids[i];
+        }
     }
 
+    manifold->sat_axis = smallest_axis;
+    set_sat_manifold(body_a, body_b, manifold, smallest, overlap);
     return true;
 }
 
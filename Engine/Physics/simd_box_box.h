@@ -0,0 +1,352 @@
+#ifndef SIMD_BOX_BOX_H
+#define SIMD_BOX_BOX_H
+
+#include "sat.h"
+
+/*  NOTE: Batched box vs box
+    The axis tests of test_box_box on 4 (SSE) or 8 (AVX2) pairs at a time. The boxes of up
+    to BOX_BOX_LANES pairs are copied into BoxBoxLanes, one array per component, then every
+    pair gets its 4 axes tested in one pass. Separated pairs are dropped there, only the
+    touching ones get the contact clipping, which stays scalar. The math is done in the same
+    order as project_box_to_axis without FMA, so the result is the same as test_box_box.
+    Like test_box_box every pair starts with the axis cached from last frame (or its first
+    axis without one) and hands back the axis that decided it, see the SAT axis cache.
+    The path follows the world's integrator path, tests/check_simd_paths.cpp verifies it
+    against the scalar kernel. Boxes only, 2D only: the PHYSICS_3D update_shape can shear a box.
+*/
+
+#define BOX_BOX_LANES 64
+
+struct BoxLanes
+{
+    float center_x[BOX_BOX_LANES];
+    float center_y[BOX_BOX_LANES];
+
+    //NOTE: Normals 0 and 1 are the tested axes, 2 and 3 the local +x and +y the box is
+    //      projected with, see project_box_to_axis
+    float axis_x[2][BOX_BOX_LANES];
+    float axis_y[2][BOX_BOX_LANES];
+    float u_x[BOX_BOX_LANES];
+    float u_y[BOX_BOX_LANES];
+    float v_x[BOX_BOX_LANES];
+    float v_y[BOX_BOX_LANES];
+    float dim_x[BOX_BOX_LANES];
+    float dim_y[BOX_BOX_LANES];
+};
+
+struct BoxBoxLanes
+{
+    int count;
+    BoxLanes a;
+    BoxLanes b;
+
+    //NOTE: Per pair, the axis tested before the others and its normal
+    int first_axis[BOX_BOX_LANES];
+    float first_x[BOX_BOX_LANES];
+    float first_y[BOX_BOX_LANES];
+
+    //NOTE: Per pair, axis is 0-1 for the normals of a, 2-3 for b and -1 once separated.
+    //      flip is set when the normal has to be negated to point from a to b. sat_axis is
+    //      the axis that separated the pair or the one of least overlap, axes_tested the
+    //      axes test_box_box projects to get there
+    float overlap[BOX_BOX_LANES];
+    int axis[BOX_BOX_LANES];
+    u32 flip[BOX_BOX_LANES];
+    int sat_axis[BOX_BOX_LANES];
+    int axes_tested[BOX_BOX_LANES];
+};
+
+//NOTE: Lane axis k is the SAT axis id test_box_box gives normal k % 2 of shape k / 2
+inline int get_box_box_sat_axis(int lane_axis)
+{
+    return make_sat_axis(lane_axis >> 1, lane_axis & 1);
+}
+
+//NOTE: -1 when sat_axis isn't one of the 4 axes of a box pair
+inline int get_box_box_lane_axis(int sat_axis)
+{
+    for(int k = 0; k < 4; ++k)
+    {
+        if(get_box_box_sat_axis(k) == sat_axis) return k;
+    }
+    return -1;
+}
+
+void set_box_lane(BoxLanes* lanes, int lane, Shape* box)
+{
+    lanes->center_x[lane] = box->center_pos.x;
+    lanes->center_y[lane] = box->center_pos.y;
+    lanes->axis_x[0][lane] = box->global_normals[0].x;
+    lanes->axis_y[0][lane] = box->global_normals[0].y;
+    lanes->axis_x[1][lane] = box->global_normals[1].x;
+    lanes->axis_y[1][lane] = box->global_normals[1].y;
+    lanes->u_x[lane] = box->global_normals[2].x;
+    lanes->u_y[lane] = box->global_normals[2].y;
+    lanes->v_x[lane] = box->global_normals[3].x;
+    lanes->v_y[lane] = box->global_normals[3].y;
+    lanes->dim_x[lane] = box->dim.x;
+    lanes->dim_y[lane] = box->dim.y;
+}
+
+//NOTE: cached_axis is the pair's SAT axis from last frame, SAT_AXIS_NONE or an axis that
+//      isn't a box axis start from axis 0 the way test_box_box does without a cache
+inline void add_box_box_lane(BoxBoxLanes* lanes, Shape* a, Shape* b, int cached_axis = SAT_AXIS_NONE)
+{
+    int lane = lanes->count;
+    set_box_lane(&lanes->a, lane, a);
+    set_box_lane(&lanes->b, lane, b);
+
+    int first = max(get_box_box_lane_axis(cached_axis), 0);
+    Vector3 n = (first < 2 ? a : b)->global_normals[first & 1];
+    lanes->first_axis[lane] = first;
+    lanes->first_x[lane] = n.x;
+    lanes->first_y[lane] = n.y;
+    ++lanes->count;
+}
+
+inline Vector2 project_box_lane(BoxLanes* box, int i, Vector3 n)
+{
+    float c = n.x * box->center_x[i] + n.y * box->center_y[i];
+    float r = 0.5f * (box->dim_x[i] * abs(box->u_x[i] * n.x + box->u_y[i] * n.y) +
+                      box->dim_y[i] * abs(box->v_x[i] * n.x + box->v_y[i] * n.y));
+    return V2(c - r, c + r);
+}
+
+void sat_box_box_lanes_scalar(BoxBoxLanes* lanes, int first, int last)
+{
+    for(int i = first; i < last; ++i)
+    {
+        int first_axis = lanes->first_axis[i];
+        Vector3 first_normal = V3(lanes->first_x[i], lanes->first_y[i], 0);
+        lanes->sat_axis[i] = first_axis;
+        lanes->axes_tested[i] = 1;
+        if(!is_projected_overlap(project_box_lane(&lanes->a, i, first_normal), project_box_lane(&lanes->b, i, first_normal)))
+        {
+            lanes->overlap[i] = FLT_MAX;
+            lanes->axis[i] = -1;
+            lanes->flip[i] = 0;
+            continue;
+        }
+
+        float overlap = FLT_MAX;
+        int best = -1;
+        u32 flip = 0;
+        for(int k = 0; k < 4; ++k)
+        {
+            BoxLanes* owner = k < 2 ? &lanes->a : &lanes->b;
+            Vector3 n = V3(owner->axis_x[k & 1][i], owner->axis_y[k & 1][i], 0);
+
+            Vector2 projection[2] = {project_box_lane(&lanes->a, i, n), project_box_lane(&lanes->b, i, n)};
+            if(k != first_axis) ++lanes->axes_tested[i];
+
+            if(!is_projected_overlap(projection[0], projection[1]))
+            {
+                best = -1;
+                lanes->sat_axis[i] = k;
+                break;
+            }
+
+            float o = get_overlap_from_projection(projection[0], projection[1]);
+            if(o < overlap)
+            {
+                overlap = o;
+                best = k;
+                flip = projection[0].y > projection[1].y;
+            }
+        }
+
+        lanes->overlap[i] = overlap;
+        lanes->axis[i] = best;
+        lanes->flip[i] = flip;
+        if(best >= 0) lanes->sat_axis[i] = best;
+    }
+}
+
+#ifdef PHYSICS_X86
+
+inline __m128 abs_x4(__m128 v)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+inline void project_box_lanes_x4(BoxLanes* box, int i, __m128 nx, __m128 ny, __m128* lo, __m128* hi)
+{
+    __m128 c = _mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(box->center_x + i)), _mm_mul_ps(ny, _mm_loadu_ps(box->center_y + i)));
+    __m128 du = abs_x4(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(box->u_x + i), nx), _mm_mul_ps(_mm_loadu_ps(box->u_y + i), ny)));
+    __m128 dv = abs_x4(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(box->v_x + i), nx), _mm_mul_ps(_mm_loadu_ps(box->v_y + i), ny)));
+    __m128 r = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(box->dim_x + i), du),
+                                                        _mm_mul_ps(_mm_loadu_ps(box->dim_y + i), dv)));
+    *lo = _mm_sub_ps(c, r);
+    *hi = _mm_add_ps(c, r);
+}
+
+void sat_box_box_lanes_sse(BoxBoxLanes* lanes)
+{
+    int wide_count = lanes->count & ~3;
+    for(int i = 0; i < wide_count; i += 4)
+    {
+        __m128 a_lo, a_hi, b_lo, b_hi;
+        __m128 first = _mm_cvtepi32_ps(_mm_loadu_si128((__m128i*)(lanes->first_axis + i)));
+        __m128 first_x = _mm_loadu_ps(lanes->first_x + i);
+        __m128 first_y = _mm_loadu_ps(lanes->first_y + i);
+        project_box_lanes_x4(&lanes->a, i, first_x, first_y, &a_lo, &a_hi);
+        project_box_lanes_x4(&lanes->b, i, first_x, first_y, &b_lo, &b_hi);
+
+        __m128 overlap = _mm_set1_ps(FLT_MAX);
+        __m128 best = _mm_setzero_ps();
+        __m128 flip = _mm_setzero_ps();
+        __m128 separated = _mm_or_ps(_mm_cmplt_ps(b_hi, a_lo), _mm_cmplt_ps(a_hi, b_lo));
+        __m128 decided = first;
+        __m128 tested = _mm_set1_ps(1.0f);
+        for(int k = 0; k < 4; ++k)
+        {
+            if(_mm_movemask_ps(separated) == 0xF) break;
+
+            BoxLanes* owner = k < 2 ? &lanes->a : &lanes->b;
+            __m128 nx = _mm_loadu_ps(owner->axis_x[k & 1] + i);
+            __m128 ny = _mm_loadu_ps(owner->axis_y[k & 1] + i);
+
+            project_box_lanes_x4(&lanes->a, i, nx, ny, &a_lo, &a_hi);
+            project_box_lanes_x4(&lanes->b, i, nx, ny, &b_lo, &b_hi);
+
+            //NOTE: A lane counts the axes it would have projected alone, the first one only once
+            __m128 axis = _mm_set1_ps((float)k);
+            __m128 counted = _mm_andnot_ps(separated, _mm_cmpneq_ps(axis, first));
+            tested = _mm_add_ps(tested, _mm_and_ps(counted, _mm_set1_ps(1.0f)));
+
+            __m128 now_separated = _mm_or_ps(separated, _mm_or_ps(_mm_cmplt_ps(b_hi, a_lo), _mm_cmplt_ps(a_hi, b_lo)));
+            decided = select_x4(_mm_andnot_ps(separated, now_separated), axis, decided);
+            separated = now_separated;
+
+            //NOTE: min/max keep the operand order of the min/max macros
+            __m128 o = _mm_sub_ps(_mm_min_ps(a_hi, b_hi), _mm_max_ps(a_lo, b_lo));
+            __m128 better = _mm_cmplt_ps(o, overlap);
+            overlap = select_x4(better, o, overlap);
+            best = select_x4(better, _mm_set1_ps((float)k), best);
+            flip = select_x4(better, _mm_cmpgt_ps(a_hi, b_hi), flip);
+        }
+
+        decided = select_x4(separated, decided, best);
+        best = select_x4(separated, _mm_set1_ps(-1.0f), best);
+        _mm_storeu_ps(lanes->overlap + i, overlap);
+        _mm_storeu_si128((__m128i*)(lanes->axis + i), _mm_cvttps_epi32(best));
+        _mm_storeu_si128((__m128i*)(lanes->flip + i), _mm_srli_epi32(_mm_castps_si128(flip), 31));
+        _mm_storeu_si128((__m128i*)(lanes->sat_axis + i), _mm_cvttps_epi32(decided));
+        _mm_storeu_si128((__m128i*)(lanes->axes_tested + i), _mm_cvttps_epi32(tested));
+    }
+
+    sat_box_box_lanes_scalar(lanes, wide_count, lanes->count);
+}
+
+inline PHYSICS_TARGET_AVX2 __m256 abs_x8(__m256 v)
+{
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), v);
+}
+
+inline PHYSICS_TARGET_AVX2 void project_box_lanes_x8(BoxLanes* box, int i, __m256 nx, __m256 ny, __m256* lo, __m256* hi)
+{
+    __m256 c = _mm256_add_ps(_mm256_mul_ps(nx, _mm256_loadu_ps(box->center_x + i)), _mm256_mul_ps(ny, _mm256_loadu_ps(box->center_y + i)));
+    __m256 du = abs_x8(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(box->u_x + i), nx), _mm256_mul_ps(_mm256_loadu_ps(box->u_y + i), ny)));
+    __m256 dv = abs_x8(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(box->v_x + i), nx), _mm256_mul_ps(_mm256_loadu_ps(box->v_y + i), ny)));
+    __m256 r = _mm256_mul_ps(_mm256_set1_ps(0.5f), _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(box->dim_x + i), du),
+                                                                 _mm256_mul_ps(_mm256_loadu_ps(box->dim_y + i), dv)));
+    *lo = _mm256_sub_ps(c, r);
+    *hi = _mm256_add_ps(c, r);
+}
+
+PHYSICS_TARGET_AVX2 void sat_box_box_lanes_avx2(BoxBoxLanes* lanes)
+{
+    int wide_count = lanes->count & ~7;
+    for(int i = 0; i < wide_count; i += 8)
+    {
+        __m256 a_lo, a_hi, b_lo, b_hi;
+        __m256 first = _mm256_cvtepi32_ps(_mm256_loadu_si256((__m256i*)(lanes->first_axis + i)));
+        __m256 first_x = _mm256_loadu_ps(lanes->first_x + i);
+        __m256 first_y = _mm256_loadu_ps(lanes->first_y + i);
+        project_box_lanes_x8(&lanes->a, i, first_x, first_y, &a_lo, &a_hi);
+        project_box_lanes_x8(&lanes->b, i, first_x, first_y, &b_lo, &b_hi);
+
+        __m256 overlap = _mm256_set1_ps(FLT_MAX);
+        __m256 best = _mm256_setzero_ps();
+        __m256 flip = _mm256_setzero_ps();
+        __m256 separated = _mm256_or_ps(_mm256_cmp_ps(b_hi, a_lo, _CMP_LT_OQ), _mm256_cmp_ps(a_hi, b_lo, _CMP_LT_OQ));
+        __m256 decided = first;
+        __m256 tested = _mm256_set1_ps(1.0f);
+        for(int k = 0; k < 4; ++k)
+        {
+            if(_mm256_movemask_ps(separated) == 0xFF) break;
+
+            BoxLanes* owner = k < 2 ? &lanes->a : &lanes->b;
+            __m256 nx = _mm256_loadu_ps(owner->axis_x[k & 1] + i);
+            __m256 ny = _mm256_loadu_ps(owner->axis_y[k & 1] + i);
+
+            project_box_lanes_x8(&lanes->a, i, nx, ny, &a_lo, &a_hi);
+            project_box_lanes_x8(&lanes->b, i, nx, ny, &b_lo, &b_hi);
+
+            __m256 axis = _mm256_set1_ps((float)k);
+            __m256 counted = _mm256_andnot_ps(separated, _mm256_cmp_ps(axis, first, _CMP_NEQ_OQ));
+            tested = _mm256_add_ps(tested, _mm256_and_ps(counted, _mm256_set1_ps(1.0f)));
+
+            __m256 now_separated = _mm256_or_ps(separated, _mm256_or_ps(_mm256_cmp_ps(b_hi, a_lo, _CMP_LT_OQ), _mm256_cmp_ps(a_hi, b_lo, _CMP_LT_OQ)));
+            decided = _mm256_blendv_ps(decided, axis, _mm256_andnot_ps(separated, now_separated));
+            separated = now_separated;
+
+            __m256 o = _mm256_sub_ps(_mm256_min_ps(a_hi, b_hi), _mm256_max_ps(a_lo, b_lo));
+            __m256 better = _mm256_cmp_ps(o, overlap, _CMP_LT_OQ);
+            overlap = _mm256_blendv_ps(overlap, o, better);
+            best = _mm256_blendv_ps(best, _mm256_set1_ps((float)k), better);
+            flip = _mm256_blendv_ps(flip, _mm256_cmp_ps(a_hi, b_hi, _CMP_GT_OQ), better);
+        }
+
+        decided = _mm256_blendv_ps(best, decided, separated);
+        best = _mm256_blendv_ps(best, _mm256_set1_ps(-1.0f), separated);
+        _mm256_storeu_ps(lanes->overlap + i, overlap);
+        _mm256_storeu_si256((__m256i*)(lanes->axis + i), _mm256_cvttps_epi32(best));
+        _mm256_storeu_si256((__m256i*)(lanes->flip + i), _mm256_srli_epi32(_mm256_castps_si256(flip), 31));
+        _mm256_storeu_si256((__m256i*)(lanes->sat_axis + i), _mm256_cvttps_epi32(decided));
+        _mm256_storeu_si256((__m256i*)(lanes->axes_tested + i), _mm256_cvttps_epi32(tested));
+    }
+
+    sat_box_box_lanes_scalar(lanes, wide_count, lanes->count);
+}
+
+#endif
+
+void sat_box_box_lanes(BoxBoxLanes* lanes, IntegratorPath path)
+{
+    switch(path)
+    {
+#ifdef PHYSICS_X86
+        case IntegratorPath::INTEGRATOR_AVX2:
+        {
+            sat_box_box_lanes_avx2(lanes);
+        } break;
+        case IntegratorPath::INTEGRATOR_SSE:
+        {
+            sat_box_box_lanes_sse(lanes);
+        } break;
+#endif
+        default:
+        {
+            sat_box_box_lanes_scalar(lanes, 0, lanes->count);
+        } break;
+    }
+}
+
+//NOTE: Contact clipping for a lane that didn't separate, same as the end of test_box_box.
+//      The deciding axis and the axes count are filled in either way
+bool set_box_box_lane_manifold(BoxBoxLanes* lanes, int lane, RigidBody* body_a, RigidBody* body_b, Manifold* manifold)
+{
+    manifold->sat_axis = get_box_box_sat_axis(lanes->sat_axis[lane]);
+    manifold->sat_axes_tested += lanes->axes_tested[lane];
+
+    int axis = lanes->axis[lane];
+    if(axis < 0) return false;
+
+    Shape* owner = axis < 2 ? &body_a->shape : &body_b->shape;
+    Vector3 normal = owner->global_normals[axis & 1];
+    set_sat_manifold(body_a, body_b, manifold, lanes->flip[lane] ? -normal : normal, lanes->overlap[lane]);
+    return true;
+}
+
+#endif
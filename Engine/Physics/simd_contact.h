@@ -0,0 +1,710 @@
+#ifndef SIMD_CONTACT_H
+#define SIMD_CONTACT_H
+
+#include "manifold.h"
+
+/*  NOTE: Contact rows
+    solve_contact_constraint works out r x n and r x t, walks the manifold for the body
+    indices and loads every body field one contact at a time. Once the contacts are prepared
+    none of that changes while iterating, so the rows keep it precomputed: one lane per
+    manifold, both of its contacts in the same lane, blocks of CONTACT_ROW_LANES lanes. The
+    lanes of a block come from one contact color and never share a dynamic body, so the
+    kernels gather the velocities, run both contacts of all lanes at once and scatter them
+    back. Static bodies and padding lanes have no inverse mass and are never written.
+    2D only, the path follows the world's integrator path like simd_box_box.h.
+*/
+
+#define CONTACT_ROW_LANES 8
+
+struct ContactRowBlock
+{
+    //NOTE: Manifold of the lane, -1 for padding
+    int manifold[CONTACT_ROW_LANES];
+    int body_a[CONTACT_ROW_LANES];
+    int body_b[CONTACT_ROW_LANES];
+
+    float inverse_mass_a[CONTACT_ROW_LANES];
+    float inverse_mass_b[CONTACT_ROW_LANES];
+    float inverse_inertia_a[CONTACT_ROW_LANES];
+    float inverse_inertia_b[CONTACT_ROW_LANES];
+    float friction[CONTACT_ROW_LANES];
+
+    //NOTE: Per contact, a manifold with one contact has zero masses in the second.
+    //      The Jacobian's angular parts, cross_angular(r, n) and cross_angular(r, t) for
+    //      both bodies, t is reverse_perp(n) like in prepare_contact
+    float normal_x[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+    float normal_y[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+    float normal_a[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+    float normal_b[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+    float tangent_a[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+    float tangent_b[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+    float normal_mass[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+    float tangent_mass[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+    float bias[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+
+    //NOTE: normal_mass above already carries the soft step's mass scale
+    float impulse_scale[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+
+    //NOTE: Accumulated impulses, the friction one as a length along the tangent
+    float sum_normal[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+    float sum_tangent[MAX_MANIFOLD_CONTACTS][CONTACT_ROW_LANES];
+
+    //NOTE: Manifold::block_solve as 1 or 0 and its K and inverse, see solve_contact_block
+    float block_solve[CONTACT_ROW_LANES];
+    float block_k[3][CONTACT_ROW_LANES];
+    float block_mass[3][CONTACT_ROW_LANES];
+};
+
+void clear_contact_lane(ContactRowBlock* block, int lane)
+{
+    block->manifold[lane] = -1;
+    block->body_a[lane] = 0;
+    block->body_b[lane] = 0;
+    block->inverse_mass_a[lane] = 0;
+    block->inverse_mass_b[lane] = 0;
+    block->inverse_inertia_a[lane] = 0;
+    block->inverse_inertia_b[lane] = 0;
+    block->friction[lane] = 0;
+    block->block_solve[lane] = 0;
+
+    for(int k = 0; k < 3; ++k)
+    {
+        block->block_k[k][lane] = 0;
+        block->block_mass[k][lane] = 0;
+    }
+
+    for(int k = 0; k < MAX_MANIFOLD_CONTACTS; ++k)
+    {
+        block->normal_x[k][lane] = 0;
+        block->normal_y[k][lane] = 0;
+        block->normal_a[k][lane] = 0;
+        block->normal_b[k][lane] = 0;
+        block->tangent_a[k][lane] = 0;
+        block->tangent_b[k][lane] = 0;
+        block->normal_mass[k][lane] = 0;
+        block->tangent_mass[k][lane] = 0;
+        block->bias[k][lane] = 0;
+        block->impulse_scale[k][lane] = 0;
+        block->sum_normal[k][lane] = 0;
+        block->sum_tangent[k][lane] = 0;
+    }
+}
+
+//NOTE: Expects prepare_contact to have run on the manifold's contacts
+void set_contact_lane(ContactRowBlock* block, int lane, BodyStore* store, Manifold* m, int manifold_index)
+{
+    clear_contact_lane(block, lane);
+
+    int a = m->index_a;
+    int b = m->index_b;
+    block->manifold[lane] = manifold_index;
+    block->body_a[lane] = a;
+    block->body_b[lane] = b;
+    block->inverse_mass_a[lane] = store->inverse_mass[a];
+    block->inverse_mass_b[lane] = store->inverse_mass[b];
+    block->inverse_inertia_a[lane] = can_rotate(store, a) ? store->inverse_inertia[a] : 0;
+    block->inverse_inertia_b[lane] = can_rotate(store, b) ? store->inverse_inertia[b] : 0;
+    block->friction[lane] = m->friction;
+
+    if(m->block_solve)
+    {
+        block->block_solve[lane] = 1;
+        for(int k = 0; k < 3; ++k)
+        {
+            block->block_k[k][lane] = m->block_k[k];
+            block->block_mass[k][lane] = m->block_mass[k];
+        }
+    }
+
+    for(int k = 0; k < m->contact_count; ++k)
+    {
+        Contact* c = &m->contacts[k];
+        block->normal_x[k][lane] = c->normal.x;
+        block->normal_y[k][lane] = c->normal.y;
+        block->normal_a[k][lane] = cross_angular(c->rel_pos_a, c->normal);
+        block->normal_b[k][lane] = cross_angular(c->rel_pos_b, c->normal);
+        block->tangent_a[k][lane] = cross_angular(c->rel_pos_a, c->tangent);
+        block->tangent_b[k][lane] = cross_angular(c->rel_pos_b, c->tangent);
+        block->normal_mass[k][lane] = c->normal_mass * c->mass_scale;
+        block->tangent_mass[k][lane] = c->tangent_mass;
+        block->bias[k][lane] = c->b;
+        block->impulse_scale[k][lane] = c->impulse_scale;
+        block->sum_normal[k][lane] = c->sum_impulse_contact;
+        block->sum_tangent[k][lane] = dot(c->sum_impulse_friction, c->tangent);
+    }
+}
+
+//NOTE: Soft step, takes the bias update_soft_contact left in the manifold's contacts
+void update_contact_lane_bias(ContactRowBlock* block, int lane, Manifold* m)
+{
+    for(int k = 0; k < m->contact_count; ++k)
+    {
+        Contact* c = &m->contacts[k];
+        block->normal_mass[k][lane] = c->normal_mass * c->mass_scale;
+        block->bias[k][lane] = c->b;
+        block->impulse_scale[k][lane] = c->impulse_scale;
+    }
+}
+
+//NOTE: Hands the accumulated impulses back to the contacts for next frame's warm start
+void store_contact_lane(ContactRowBlock* block, int lane, Manifold* m)
+{
+    for(int k = 0; k < m->contact_count; ++k)
+    {
+        Contact* c = &m->contacts[k];
+        c->sum_impulse_contact = block->sum_normal[k][lane];
+        c->sum_impulse_friction = c->tangent * block->sum_tangent[k][lane];
+    }
+}
+
+/*  NOTE: Same rows as solve_manifold: friction then normal for each contact, the normals
+    of a block lane together after both friction rows. Along a direction d (n or t) with
+    rd = cross_angular(r, d):
+    relative velocity  (vb - va) . d - wb * rb_d + wa * ra_d
+    impulse lambda     va -= d * lambda * ma, wa += ia * ra_d * lambda, b the other way
+    The SIMD kernels run both orders on every lane, the normal rows of a block lane get no
+    mass and the block result is only kept on block lanes.
+*/
+struct ContactVelocity
+{
+    float vax, vay, wa;
+    float vbx, vby, wb;
+};
+
+inline float get_row_velocity(ContactVelocity* v, float dx, float dy, float ra, float rb)
+{
+    return (v->vbx - v->vax) * dx + (v->vby - v->vay) * dy - v->wb * rb + v->wa * ra;
+}
+
+inline void apply_row_impulse(ContactVelocity* v, ContactRowBlock* block, int i, float dx, float dy, float ra, float rb, float p)
+{
+    v->vax -= dx * p * block->inverse_mass_a[i];
+    v->vay -= dy * p * block->inverse_mass_a[i];
+    v->wa += block->inverse_inertia_a[i] * ra * p;
+    v->vbx += dx * p * block->inverse_mass_b[i];
+    v->vby += dy * p * block->inverse_mass_b[i];
+    v->wb -= block->inverse_inertia_b[i] * rb * p;
+}
+
+inline void solve_friction_row(ContactVelocity* v, ContactRowBlock* block, int i, int k)
+{
+    float tx = block->normal_y[k][i];
+    float ty = -block->normal_x[k][i];
+    float ra = block->tangent_a[k][i];
+    float rb = block->tangent_b[k][i];
+    float lambda = -get_row_velocity(v, tx, ty, ra, rb) * block->tangent_mass[k][i];
+    float max_friction = block->friction[i] * block->sum_normal[k][i];
+
+    float old_sum = block->sum_tangent[k][i];
+    float new_sum = min(max(old_sum + lambda, -max_friction), max_friction);
+    block->sum_tangent[k][i] = new_sum;
+    apply_row_impulse(v, block, i, tx, ty, ra, rb, new_sum - old_sum);
+}
+
+inline void solve_normal_row(ContactVelocity* v, ContactRowBlock* block, int i, int k)
+{
+    float nx = block->normal_x[k][i];
+    float ny = block->normal_y[k][i];
+    float ra = block->normal_a[k][i];
+    float rb = block->normal_b[k][i];
+    float old_sum = block->sum_normal[k][i];
+    float lambda = -(get_row_velocity(v, nx, ny, ra, rb) + block->bias[k][i]) * block->normal_mass[k][i] - block->impulse_scale[k][i] * old_sum;
+    float new_sum = max(old_sum + lambda, 0);
+    block->sum_normal[k][i] = new_sum;
+    apply_row_impulse(v, block, i, nx, ny, ra, rb, new_sum - old_sum);
+}
+
+//NOTE: solve_contact_block on a lane, the cases are picked in the same order
+inline void solve_normal_block(ContactVelocity* v, ContactRowBlock* block, int i)
+{
+    float a1 = block->sum_normal[0][i];
+    float a2 = block->sum_normal[1][i];
+    float k11 = block->block_k[0][i];
+    float k12 = block->block_k[1][i];
+    float k22 = block->block_k[2][i];
+
+    float vn1 = get_row_velocity(v, block->normal_x[0][i], block->normal_y[0][i], block->normal_a[0][i], block->normal_b[0][i]);
+    float vn2 = get_row_velocity(v, block->normal_x[1][i], block->normal_y[1][i], block->normal_a[1][i], block->normal_b[1][i]);
+    float b1 = (vn1 + block->bias[0][i]) - (k11 * a1 + k12 * a2);
+    float b2 = (vn2 + block->bias[1][i]) - (k12 * a1 + k22 * a2);
+
+    float x1 = -(block->block_mass[0][i] * b1 + block->block_mass[1][i] * b2);
+    float x2 = -(block->block_mass[1][i] * b1 + block->block_mass[2][i] * b2);
+    float y1 = -(block->normal_mass[0][i] * b1);
+    float z2 = -(block->normal_mass[1][i] * b2);
+    if(x1 >= 0 && x2 >= 0)
+    {
+    }
+    else if(y1 >= 0 && k12 * y1 + b2 >= 0)
+    {
+        x1 = y1;
+        x2 = 0;
+    }
+    else if(z2 >= 0 && k12 * z2 + b1 >= 0)
+    {
+        x1 = 0;
+        x2 = z2;
+    }
+    else if(b1 >= 0 && b2 >= 0)
+    {
+        x1 = 0;
+        x2 = 0;
+    }
+    else
+    {
+        return;
+    }
+
+    block->sum_normal[0][i] = x1;
+    block->sum_normal[1][i] = x2;
+    apply_row_impulse(v, block, i, block->normal_x[0][i], block->normal_y[0][i], block->normal_a[0][i], block->normal_b[0][i], x1 - a1);
+    apply_row_impulse(v, block, i, block->normal_x[1][i], block->normal_y[1][i], block->normal_a[1][i], block->normal_b[1][i], x2 - a2);
+}
+
+void solve_contact_rows_scalar(BodyStore* store, ContactRowBlock* block, int first, int last)
+{
+    for(int i = first; i < last; ++i)
+    {
+        int a = block->body_a[i];
+        int b = block->body_b[i];
+
+        ContactVelocity v;
+        v.vax = store->velocity[a].x;
+        v.vay = store->velocity[a].y;
+        v.wa = store->angular_velocity[a];
+        v.vbx = store->velocity[b].x;
+        v.vby = store->velocity[b].y;
+        v.wb = store->angular_velocity[b];
+
+        if(block->block_solve[i])
+        {
+            solve_friction_row(&v, block, i, 0);
+            solve_friction_row(&v, block, i, 1);
+            solve_normal_block(&v, block, i);
+        }
+        else
+        {
+            for(int k = 0; k < MAX_MANIFOLD_CONTACTS; ++k)
+            {
+                solve_friction_row(&v, block, i, k);
+                solve_normal_row(&v, block, i, k);
+            }
+        }
+
+        if(block->inverse_mass_a[i] != 0)
+        {
+            store->velocity[a].x = v.vax;
+            store->velocity[a].y = v.vay;
+            store->angular_velocity[a] = v.wa;
+        }
+        if(block->inverse_mass_b[i] != 0)
+        {
+            store->velocity[b].x = v.vbx;
+            store->velocity[b].y = v.vby;
+            store->angular_velocity[b] = v.wb;
+        }
+    }
+}
+
+//NOTE: Soft step, applies the accumulated impulses again at the start of every substep
+void warm_start_contact_lane(BodyStore* store, ContactRowBlock* block, int i)
+{
+    int a = block->body_a[i];
+    int b = block->body_b[i];
+
+    ContactVelocity v;
+    v.vax = store->velocity[a].x;
+    v.vay = store->velocity[a].y;
+    v.wa = store->angular_velocity[a];
+    v.vbx = store->velocity[b].x;
+    v.vby = store->velocity[b].y;
+    v.wb = store->angular_velocity[b];
+
+    for(int k = 0; k < MAX_MANIFOLD_CONTACTS; ++k)
+    {
+        float nx = block->normal_x[k][i];
+        float ny = block->normal_y[k][i];
+        apply_row_impulse(&v, block, i, nx, ny, block->normal_a[k][i], block->normal_b[k][i], block->sum_normal[k][i]);
+        apply_row_impulse(&v, block, i, ny, -nx, block->tangent_a[k][i], block->tangent_b[k][i], block->sum_tangent[k][i]);
+    }
+
+    if(block->inverse_mass_a[i] != 0)
+    {
+        store->velocity[a].x = v.vax;
+        store->velocity[a].y = v.vay;
+        store->angular_velocity[a] = v.wa;
+    }
+    if(block->inverse_mass_b[i] != 0)
+    {
+        store->velocity[b].x = v.vbx;
+        store->velocity[b].y = v.vby;
+        store->angular_velocity[b] = v.wb;
+    }
+}
+
+#ifdef PHYSICS_X86
+
+//NOTE: Writes lanes with an inverse mass back, AVX2 has no scatter
+inline void scatter_contact_velocity(BodyStore* store, int* body, float* inverse_mass, float* vx, float* vy, float* w, int count)
+{
+    for(int i = 0; i < count; ++i)
+    {
+        if(inverse_mass[i] != 0)
+        {
+            store->velocity[body[i]].x = vx[i];
+            store->velocity[body[i]].y = vy[i];
+            store->angular_velocity[body[i]] = w[i];
+        }
+    }
+}
+
+struct ContactVelocityX4
+{
+    __m128 vax, vay, wa;
+    __m128 vbx, vby, wb;
+    __m128 ma, mb, ia, ib;
+};
+
+inline __m128 get_row_velocity_x4(ContactVelocityX4* v, __m128 dx, __m128 dy, __m128 ra, __m128 rb)
+{
+    return _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(v->vbx, v->vax), dx), _mm_mul_ps(_mm_sub_ps(v->vby, v->vay), dy)),
+                                 _mm_mul_ps(v->wb, rb)),
+                      _mm_mul_ps(v->wa, ra));
+}
+
+inline void apply_row_impulse_x4(ContactVelocityX4* v, __m128 dx, __m128 dy, __m128 ra, __m128 rb, __m128 p)
+{
+    v->vax = _mm_sub_ps(v->vax, _mm_mul_ps(_mm_mul_ps(dx, p), v->ma));
+    v->vay = _mm_sub_ps(v->vay, _mm_mul_ps(_mm_mul_ps(dy, p), v->ma));
+    v->wa = _mm_add_ps(v->wa, _mm_mul_ps(_mm_mul_ps(v->ia, ra), p));
+    v->vbx = _mm_add_ps(v->vbx, _mm_mul_ps(_mm_mul_ps(dx, p), v->mb));
+    v->vby = _mm_add_ps(v->vby, _mm_mul_ps(_mm_mul_ps(dy, p), v->mb));
+    v->wb = _mm_sub_ps(v->wb, _mm_mul_ps(_mm_mul_ps(v->ib, rb), p));
+}
+
+inline __m128 negate_x4(__m128 v)
+{
+    return _mm_sub_ps(_mm_setzero_ps(), v);
+}
+
+inline __m128 greater_equal_zero_x4(__m128 v)
+{
+    return _mm_cmpge_ps(v, _mm_setzero_ps());
+}
+
+void solve_contact_rows_sse(BodyStore* store, ContactRowBlock* block)
+{
+    float* velocity = (float*)store->velocity.data();
+    float* angular_velocity = (float*)store->angular_velocity.data();
+    const int stride = sizeof(Vector3) / sizeof(float);
+
+    for(int i = 0; i < CONTACT_ROW_LANES; i += 4)
+    {
+        alignas(16) float gathered[6][4];
+        for(int j = 0; j < 4; ++j)
+        {
+            int a = block->body_a[i + j];
+            int b = block->body_b[i + j];
+            gathered[0][j] = velocity[a * stride];
+            gathered[1][j] = velocity[a * stride + 1];
+            gathered[2][j] = angular_velocity[a];
+            gathered[3][j] = velocity[b * stride];
+            gathered[4][j] = velocity[b * stride + 1];
+            gathered[5][j] = angular_velocity[b];
+        }
+
+        ContactVelocityX4 v;
+        v.vax = _mm_load_ps(gathered[0]);
+        v.vay = _mm_load_ps(gathered[1]);
+        v.wa = _mm_load_ps(gathered[2]);
+        v.vbx = _mm_load_ps(gathered[3]);
+        v.vby = _mm_load_ps(gathered[4]);
+        v.wb = _mm_load_ps(gathered[5]);
+        v.ma = _mm_loadu_ps(block->inverse_mass_a + i);
+        v.mb = _mm_loadu_ps(block->inverse_mass_b + i);
+        v.ia = _mm_loadu_ps(block->inverse_inertia_a + i);
+        v.ib = _mm_loadu_ps(block->inverse_inertia_b + i);
+
+        __m128 friction = _mm_loadu_ps(block->friction + i);
+        __m128 block_lanes = _mm_cmpneq_ps(_mm_loadu_ps(block->block_solve + i), _mm_setzero_ps());
+
+        for(int k = 0; k < MAX_MANIFOLD_CONTACTS; ++k)
+        {
+            __m128 nx = _mm_loadu_ps(block->normal_x[k] + i);
+            __m128 ny = _mm_loadu_ps(block->normal_y[k] + i);
+            __m128 sum_normal = _mm_loadu_ps(block->sum_normal[k] + i);
+
+            //Friction
+            __m128 tx = ny;
+            __m128 ty = negate_x4(nx);
+            __m128 ra = _mm_loadu_ps(block->tangent_a[k] + i);
+            __m128 rb = _mm_loadu_ps(block->tangent_b[k] + i);
+            __m128 lambda = _mm_mul_ps(negate_x4(get_row_velocity_x4(&v, tx, ty, ra, rb)),
+                                       _mm_loadu_ps(block->tangent_mass[k] + i));
+            __m128 max_friction = _mm_mul_ps(friction, sum_normal);
+
+            __m128 old_sum = _mm_loadu_ps(block->sum_tangent[k] + i);
+            __m128 new_sum = _mm_min_ps(_mm_max_ps(_mm_add_ps(old_sum, lambda), negate_x4(max_friction)), max_friction);
+            _mm_storeu_ps(block->sum_tangent[k] + i, new_sum);
+            apply_row_impulse_x4(&v, tx, ty, ra, rb, _mm_sub_ps(new_sum, old_sum));
+
+            //Resolution, block lanes get no mass here
+            ra = _mm_loadu_ps(block->normal_a[k] + i);
+            rb = _mm_loadu_ps(block->normal_b[k] + i);
+            __m128 mass = _mm_andnot_ps(block_lanes, _mm_loadu_ps(block->normal_mass[k] + i));
+            lambda = _mm_mul_ps(negate_x4(_mm_add_ps(get_row_velocity_x4(&v, nx, ny, ra, rb), _mm_loadu_ps(block->bias[k] + i))), mass);
+            lambda = _mm_sub_ps(lambda, _mm_mul_ps(_mm_loadu_ps(block->impulse_scale[k] + i), sum_normal));
+
+            new_sum = _mm_max_ps(_mm_add_ps(sum_normal, lambda), _mm_setzero_ps());
+            new_sum = select_x4(block_lanes, sum_normal, new_sum);
+            _mm_storeu_ps(block->sum_normal[k] + i, new_sum);
+            apply_row_impulse_x4(&v, nx, ny, ra, rb, _mm_sub_ps(new_sum, sum_normal));
+        }
+
+        if(_mm_movemask_ps(block_lanes))
+        {
+            __m128 nx1 = _mm_loadu_ps(block->normal_x[0] + i);
+            __m128 ny1 = _mm_loadu_ps(block->normal_y[0] + i);
+            __m128 ra1 = _mm_loadu_ps(block->normal_a[0] + i);
+            __m128 rb1 = _mm_loadu_ps(block->normal_b[0] + i);
+            __m128 nx2 = _mm_loadu_ps(block->normal_x[1] + i);
+            __m128 ny2 = _mm_loadu_ps(block->normal_y[1] + i);
+            __m128 ra2 = _mm_loadu_ps(block->normal_a[1] + i);
+            __m128 rb2 = _mm_loadu_ps(block->normal_b[1] + i);
+
+            __m128 a1 = _mm_loadu_ps(block->sum_normal[0] + i);
+            __m128 a2 = _mm_loadu_ps(block->sum_normal[1] + i);
+            __m128 k11 = _mm_loadu_ps(block->block_k[0] + i);
+            __m128 k12 = _mm_loadu_ps(block->block_k[1] + i);
+            __m128 k22 = _mm_loadu_ps(block->block_k[2] + i);
+
+            __m128 vn1 = get_row_velocity_x4(&v, nx1, ny1, ra1, rb1);
+            __m128 vn2 = get_row_velocity_x4(&v, nx2, ny2, ra2, rb2);
+            __m128 b1 = _mm_sub_ps(_mm_add_ps(vn1, _mm_loadu_ps(block->bias[0] + i)), _mm_add_ps(_mm_mul_ps(k11, a1), _mm_mul_ps(k12, a2)));
+            __m128 b2 = _mm_sub_ps(_mm_add_ps(vn2, _mm_loadu_ps(block->bias[1] + i)), _mm_add_ps(_mm_mul_ps(k12, a1), _mm_mul_ps(k22, a2)));
+
+            __m128 m11 = _mm_loadu_ps(block->block_mass[0] + i);
+            __m128 m12 = _mm_loadu_ps(block->block_mass[1] + i);
+            __m128 m22 = _mm_loadu_ps(block->block_mass[2] + i);
+            __m128 x1 = negate_x4(_mm_add_ps(_mm_mul_ps(m11, b1), _mm_mul_ps(m12, b2)));
+            __m128 x2 = negate_x4(_mm_add_ps(_mm_mul_ps(m12, b1), _mm_mul_ps(m22, b2)));
+            __m128 y1 = negate_x4(_mm_mul_ps(_mm_loadu_ps(block->normal_mass[0] + i), b1));
+            __m128 z2 = negate_x4(_mm_mul_ps(_mm_loadu_ps(block->normal_mass[1] + i), b2));
+
+            //NOTE: Cases from last to first so the first one that fits wins
+            __m128 case_both = _mm_and_ps(greater_equal_zero_x4(x1), greater_equal_zero_x4(x2));
+            __m128 case_first = _mm_and_ps(greater_equal_zero_x4(y1), greater_equal_zero_x4(_mm_add_ps(_mm_mul_ps(k12, y1), b2)));
+            __m128 case_second = _mm_and_ps(greater_equal_zero_x4(z2), greater_equal_zero_x4(_mm_add_ps(_mm_mul_ps(k12, z2), b1)));
+            __m128 case_none = _mm_and_ps(greater_equal_zero_x4(b1), greater_equal_zero_x4(b2));
+
+            __m128 new_1 = select_x4(case_none, _mm_setzero_ps(), a1);
+            __m128 new_2 = select_x4(case_none, _mm_setzero_ps(), a2);
+            new_1 = select_x4(case_second, _mm_setzero_ps(), new_1);
+            new_2 = select_x4(case_second, z2, new_2);
+            new_1 = select_x4(case_first, y1, new_1);
+            new_2 = select_x4(case_first, _mm_setzero_ps(), new_2);
+            new_1 = select_x4(case_both, x1, new_1);
+            new_2 = select_x4(case_both, x2, new_2);
+            new_1 = select_x4(block_lanes, new_1, a1);
+            new_2 = select_x4(block_lanes, new_2, a2);
+
+            _mm_storeu_ps(block->sum_normal[0] + i, new_1);
+            _mm_storeu_ps(block->sum_normal[1] + i, new_2);
+            apply_row_impulse_x4(&v, nx1, ny1, ra1, rb1, _mm_sub_ps(new_1, a1));
+            apply_row_impulse_x4(&v, nx2, ny2, ra2, rb2, _mm_sub_ps(new_2, a2));
+        }
+
+        _mm_store_ps(gathered[0], v.vax);
+        _mm_store_ps(gathered[1], v.vay);
+        _mm_store_ps(gathered[2], v.wa);
+        _mm_store_ps(gathered[3], v.vbx);
+        _mm_store_ps(gathered[4], v.vby);
+        _mm_store_ps(gathered[5], v.wb);
+        scatter_contact_velocity(store, block->body_a + i, block->inverse_mass_a + i, gathered[0], gathered[1], gathered[2], 4);
+        scatter_contact_velocity(store, block->body_b + i, block->inverse_mass_b + i, gathered[3], gathered[4], gathered[5], 4);
+    }
+}
+
+struct ContactVelocityX8
+{
+    __m256 vax, vay, wa;
+    __m256 vbx, vby, wb;
+    __m256 ma, mb, ia, ib;
+};
+
+inline PHYSICS_TARGET_AVX2 __m256 get_row_velocity_x8(ContactVelocityX8* v, __m256 dx, __m256 dy, __m256 ra, __m256 rb)
+{
+    return _mm256_add_ps(_mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(v->vbx, v->vax), dx), _mm256_mul_ps(_mm256_sub_ps(v->vby, v->vay), dy)),
+                                       _mm256_mul_ps(v->wb, rb)),
+                         _mm256_mul_ps(v->wa, ra));
+}
+
+inline PHYSICS_TARGET_AVX2 void apply_row_impulse_x8(ContactVelocityX8* v, __m256 dx, __m256 dy, __m256 ra, __m256 rb, __m256 p)
+{
+    v->vax = _mm256_sub_ps(v->vax, _mm256_mul_ps(_mm256_mul_ps(dx, p), v->ma));
+    v->vay = _mm256_sub_ps(v->vay, _mm256_mul_ps(_mm256_mul_ps(dy, p), v->ma));
+    v->wa = _mm256_add_ps(v->wa, _mm256_mul_ps(_mm256_mul_ps(v->ia, ra), p));
+    v->vbx = _mm256_add_ps(v->vbx, _mm256_mul_ps(_mm256_mul_ps(dx, p), v->mb));
+    v->vby = _mm256_add_ps(v->vby, _mm256_mul_ps(_mm256_mul_ps(dy, p), v->mb));
+    v->wb = _mm256_sub_ps(v->wb, _mm256_mul_ps(_mm256_mul_ps(v->ib, rb), p));
+}
+
+inline PHYSICS_TARGET_AVX2 __m256 negate_x8(__m256 v)
+{
+    return _mm256_sub_ps(_mm256_setzero_ps(), v);
+}
+
+inline PHYSICS_TARGET_AVX2 __m256 greater_equal_zero_x8(__m256 v)
+{
+    return _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GE_OQ);
+}
+
+PHYSICS_TARGET_AVX2 void solve_contact_rows_avx2(BodyStore* store, ContactRowBlock* block)
+{
+    float* velocity = (float*)store->velocity.data();
+    float* angular_velocity = (float*)store->angular_velocity.data();
+    __m256i stride = _mm256_set1_epi32(sizeof(Vector3) / sizeof(float));
+
+    __m256i body_a = _mm256_loadu_si256((__m256i*)block->body_a);
+    __m256i body_b = _mm256_loadu_si256((__m256i*)block->body_b);
+    __m256i offset_a = _mm256_mullo_epi32(body_a, stride);
+    __m256i offset_b = _mm256_mullo_epi32(body_b, stride);
+
+    ContactVelocityX8 v;
+    v.vax = _mm256_i32gather_ps(velocity, offset_a, 4);
+    v.vay = _mm256_i32gather_ps(velocity + 1, offset_a, 4);
+    v.wa = _mm256_i32gather_ps(angular_velocity, body_a, 4);
+    v.vbx = _mm256_i32gather_ps(velocity, offset_b, 4);
+    v.vby = _mm256_i32gather_ps(velocity + 1, offset_b, 4);
+    v.wb = _mm256_i32gather_ps(angular_velocity, body_b, 4);
+    v.ma = _mm256_loadu_ps(block->inverse_mass_a);
+    v.mb = _mm256_loadu_ps(block->inverse_mass_b);
+    v.ia = _mm256_loadu_ps(block->inverse_inertia_a);
+    v.ib = _mm256_loadu_ps(block->inverse_inertia_b);
+
+    __m256 friction = _mm256_loadu_ps(block->friction);
+    __m256 block_lanes = _mm256_cmp_ps(_mm256_loadu_ps(block->block_solve), _mm256_setzero_ps(), _CMP_NEQ_OQ);
+
+    for(int k = 0; k < MAX_MANIFOLD_CONTACTS; ++k)
+    {
+        __m256 nx = _mm256_loadu_ps(block->normal_x[k]);
+        __m256 ny = _mm256_loadu_ps(block->normal_y[k]);
+        __m256 sum_normal = _mm256_loadu_ps(block->sum_normal[k]);
+
+        //Friction
+        __m256 tx = ny;
+        __m256 ty = negate_x8(nx);
+        __m256 ra = _mm256_loadu_ps(block->tangent_a[k]);
+        __m256 rb = _mm256_loadu_ps(block->tangent_b[k]);
+        __m256 lambda = _mm256_mul_ps(negate_x8(get_row_velocity_x8(&v, tx, ty, ra, rb)),
+                                      _mm256_loadu_ps(block->tangent_mass[k]));
+        __m256 max_friction = _mm256_mul_ps(friction, sum_normal);
+
+        __m256 old_sum = _mm256_loadu_ps(block->sum_tangent[k]);
+        __m256 new_sum = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(old_sum, lambda), negate_x8(max_friction)), max_friction);
+        _mm256_storeu_ps(block->sum_tangent[k], new_sum);
+        apply_row_impulse_x8(&v, tx, ty, ra, rb, _mm256_sub_ps(new_sum, old_sum));
+
+        //Resolution, block lanes get no mass here
+        ra = _mm256_loadu_ps(block->normal_a[k]);
+        rb = _mm256_loadu_ps(block->normal_b[k]);
+        __m256 mass = _mm256_andnot_ps(block_lanes, _mm256_loadu_ps(block->normal_mass[k]));
+        lambda = _mm256_mul_ps(negate_x8(_mm256_add_ps(get_row_velocity_x8(&v, nx, ny, ra, rb), _mm256_loadu_ps(block->bias[k]))), mass);
+        lambda = _mm256_sub_ps(lambda, _mm256_mul_ps(_mm256_loadu_ps(block->impulse_scale[k]), sum_normal));
+
+        new_sum = _mm256_max_ps(_mm256_add_ps(sum_normal, lambda), _mm256_setzero_ps());
+        new_sum = _mm256_blendv_ps(new_sum, sum_normal, block_lanes);
+        _mm256_storeu_ps(block->sum_normal[k], new_sum);
+        apply_row_impulse_x8(&v, nx, ny, ra, rb, _mm256_sub_ps(new_sum, sum_normal));
+    }
+
+    if(_mm256_movemask_ps(block_lanes))
+    {
+        __m256 nx1 = _mm256_loadu_ps(block->normal_x[0]);
+        __m256 ny1 = _mm256_loadu_ps(block->normal_y[0]);
+        __m256 ra1 = _mm256_loadu_ps(block->normal_a[0]);
+        __m256 rb1 = _mm256_loadu_ps(block->normal_b[0]);
+        __m256 nx2 = _mm256_loadu_ps(block->normal_x[1]);
+        __m256 ny2 = _mm256_loadu_ps(block->normal_y[1]);
+        __m256 ra2 = _mm256_loadu_ps(block->normal_a[1]);
+        __m256 rb2 = _mm256_loadu_ps(block->normal_b[1]);
+
+        __m256 a1 = _mm256_loadu_ps(block->sum_normal[0]);
+        __m256 a2 = _mm256_loadu_ps(block->sum_normal[1]);
+        __m256 k11 = _mm256_loadu_ps(block->block_k[0]);
+        __m256 k12 = _mm256_loadu_ps(block->block_k[1]);
+        __m256 k22 = _mm256_loadu_ps(block->block_k[2]);
+
+        __m256 vn1 = get_row_velocity_x8(&v, nx1, ny1, ra1, rb1);
+        __m256 vn2 = get_row_velocity_x8(&v, nx2, ny2, ra2, rb2);
+        __m256 b1 = _mm256_sub_ps(_mm256_add_ps(vn1, _mm256_loadu_ps(block->bias[0])), _mm256_add_ps(_mm256_mul_ps(k11, a1), _mm256_mul_ps(k12, a2)));
+        __m256 b2 = _mm256_sub_ps(_mm256_add_ps(vn2, _mm256_loadu_ps(block->bias[1])), _mm256_add_ps(_mm256_mul_ps(k12, a1), _mm256_mul_ps(k22, a2)));
+
+        __m256 m11 = _mm256_loadu_ps(block->block_mass[0]);
+        __m256 m12 = _mm256_loadu_ps(block->block_mass[1]);
+        __m256 m22 = _mm256_loadu_ps(block->block_mass[2]);
+        __m256 x1 = negate_x8(_mm256_add_ps(_mm256_mul_ps(m11, b1), _mm256_mul_ps(m12, b2)));
+        __m256 x2 = negate_x8(_mm256_add_ps(_mm256_mul_ps(m12, b1), _mm256_mul_ps(m22, b2)));
+        __m256 y1 = negate_x8(_mm256_mul_ps(_mm256_loadu_ps(block->normal_mass[0]), b1));
+        __m256 z2 = negate_x8(_mm256_mul_ps(_mm256_loadu_ps(block->normal_mass[1]), b2));
+
+        __m256 case_both = _mm256_and_ps(greater_equal_zero_x8(x1), greater_equal_zero_x8(x2));
+        __m256 case_first = _mm256_and_ps(greater_equal_zero_x8(y1), greater_equal_zero_x8(_mm256_add_ps(_mm256_mul_ps(k12, y1), b2)));
+        __m256 case_second = _mm256_and_ps(greater_equal_zero_x8(z2), greater_equal_zero_x8(_mm256_add_ps(_mm256_mul_ps(k12, z2), b1)));
+        __m256 case_none = _mm256_and_ps(greater_equal_zero_x8(b1), greater_equal_zero_x8(b2));
+
+        __m256 new_1 = _mm256_blendv_ps(a1, _mm256_setzero_ps(), case_none);
+        __m256 new_2 = _mm256_blendv_ps(a2, _mm256_setzero_ps(), case_none);
+        new_1 = _mm256_blendv_ps(new_1, _mm256_setzero_ps(), case_second);
+        new_2 = _mm256_blendv_ps(new_2, z2, case_second);
+        new_1 = _mm256_blendv_ps(new_1, y1, case_first);
+        new_2 = _mm256_blendv_ps(new_2, _mm256_setzero_ps(), case_first);
+        new_1 = _mm256_blendv_ps(new_1, x1, case_both);
+        new_2 = _mm256_blendv_ps(new_2, x2, case_both);
+        new_1 = _mm256_blendv_ps(a1, new_1, block_lanes);
+        new_2 = _mm256_blendv_ps(a2, new_2, block_lanes);
+
+        _mm256_storeu_ps(block->sum_normal[0], new_1);
+        _mm256_storeu_ps(block->sum_normal[1], new_2);
+        apply_row_impulse_x8(&v, nx1, ny1, ra1, rb1, _mm256_sub_ps(new_1, a1));
+        apply_row_impulse_x8(&v, nx2, ny2, ra2, rb2, _mm256_sub_ps(new_2, a2));
+    }
+
+    alignas(32) float scattered[6][CONTACT_ROW_LANES];
+    _mm256_store_ps(scattered[0], v.vax);
+    _mm256_store_ps(scattered[1], v.vay);
+    _mm256_store_ps(scattered[2], v.wa);
+    _mm256_store_ps(scattered[3], v.vbx);
+    _mm256_store_ps(scattered[4], v.vby);
+    _mm256_store_ps(scattered[5], v.wb);
+    scatter_contact_velocity(store, block->body_a, block->inverse_mass_a, scattered[0], scattered[1], scattered[2], CONTACT_ROW_LANES);
+    scatter_contact_velocity(store, block->body_b, block->inverse_mass_b, scattered[3], scattered[4], scattered[5], CONTACT_ROW_LANES);
+}
+
+#endif
+
+void solve_contact_rows(BodyStore* store, ContactRowBlock* blocks, int block_count, IntegratorPath path)
+{
+    for(int i = 0; i < block_count; ++i)
+    {
+        switch(path)
+        {
+#ifdef PHYSICS_X86
+            case IntegratorPath::INTEGRATOR_AVX2:
+            {
+                solve_contact_rows_avx2(store, &blocks[i]);
+            } break;
+            case IntegratorPath::INTEGRATOR_SSE:
+            {
+                solve_contact_rows_sse(store, &blocks[i]);
+            } break;
+#endif
+            default:
+            {
+                solve_contact_rows_scalar(store, &blocks[i], 0, CONTACT_ROW_LANES);
+            } break;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,652 @@
+#ifndef SIMD_INTEGRATE_H
+#define SIMD_INTEGRATE_H
+
+#include "body_store.h"
+
+/*  NOTE: Integrator kernels
+    Same math as the scalar loops, run on 4 (SSE) or 8 (AVX2) bodies at a time. The store
+    keeps Vector3 arrays, so each block is transposed into one register per component on
+    load and back on store. 2D rotations are cos/sin pairs that only need a deinterleave,
+    the PHYSICS_3D quaternions get a 4x4 transpose. Sleeping, static and frozen bodies are
+    handled with lane masks, the leftover bodies at the end go through the scalar path.
+    Every operation is done in the same order as the scalar code and there is no FMA, so
+    the paths normally agree bit for bit. tests/check_simd_paths.cpp verifies that.
+    The path is picked from cpuid when the world is created, the scalar one is the
+    reference and the only one on non x86 targets.
+*/
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PHYSICS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PHYSICS_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define PHYSICS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+enum IntegratorPath
+{
+    INTEGRATOR_SCALAR,
+    INTEGRATOR_SSE,
+    INTEGRATOR_AVX2,
+};
+
+void integrate_velocity_scalar(BodyStore* store, int first, int last, float dt, float damping)
+{
+    Vector3* velocity = store->velocity.data();
+    Angular* angular_velocity = store->angular_velocity.data();
+    Vector3* force = store->force.data();
+    Angular* torque = store->torque.data();
+    float* inverse_mass = store->inverse_mass.data();
+    InverseInertia* inverse_inertia = store->inverse_inertia.data();
+    u32* flags = store->flags.data();
+
+    Vector3 gravity = physics_gravity * dt;
+
+    for(int i = first; i < last; ++i)
+    {
+        if(flags[i] & BODY_SLEEPING) continue;
+
+        Vector3 v = velocity[i];
+        if(inverse_mass[i] > 0)
+        {
+            v += gravity;
+        }
+        v += force[i] * inverse_mass[i] * dt;
+        v.x = v.x * damping;
+        velocity[i] = v;
+
+        if(!(flags[i] & BODY_FREEZE_ORIENTATION))
+        {
+            angular_velocity[i] = (angular_velocity[i] + inverse_inertia[i] * torque[i] * dt) * damping;
+        }
+    }
+}
+
+void integrate_position_scalar(BodyStore* store, int first, int last, float dt)
+{
+    Vector3* position = store->position.data();
+    Vector3* velocity = store->velocity.data();
+    Angular* angular_velocity = store->angular_velocity.data();
+    Rotation* orientation = store->orientation.data();
+    u32* flags = store->flags.data();
+
+    for(int i = first; i < last; ++i)
+    {
+        if(flags[i] & BODY_SLEEPING) continue;
+
+        position[i] += velocity[i] * dt;
+        if(!(flags[i] & BODY_FREEZE_ORIENTATION))
+        {
+            orientation[i] = rotate_orientation(orientation[i], angular_velocity[i] * dt);
+        }
+    }
+}
+
+#ifdef PHYSICS_X86
+
+//NOTE: 4 Vector3 in memory are x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+inline void load_vector3_x4(Vector3* v, __m128* x, __m128* y, __m128* z)
+{
+    float* f = (float*)v;
+    __m128 a = _mm_loadu_ps(f);
+    __m128 b = _mm_loadu_ps(f + 4);
+    __m128 c = _mm_loadu_ps(f + 8);
+
+    *x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 3, 0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 1, 0));
+    *y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+    *z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+inline void store_vector3_x4(Vector3* v, __m128 x, __m128 y, __m128 z)
+{
+    float* f = (float*)v;
+    _mm_storeu_ps(f, _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(f + 4, _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(f + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+//NOTE: SSE2 has no blendv
+inline __m128 select_x4(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128 flag_clear_x4(u32* flags, u32 flag)
+{
+    __m128i f = _mm_loadu_si128((__m128i*)flags);
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(f, _mm_set1_epi32((int)flag)), _mm_setzero_si128()));
+}
+
+void integrate_velocity_sse(BodyStore* store, float dt, float damping)
+{
+    int wide_count = store->count & ~3;
+
+    Vector3* velocity = store->velocity.data();
+    Angular* angular_velocity = store->angular_velocity.data();
+    Vector3* force = store->force.data();
+    Angular* torque = store->torque.data();
+    float* inverse_mass = store->inverse_mass.data();
+    InverseInertia* inverse_inertia = store->inverse_inertia.data();
+    u32* flags = store->flags.data();
+
+    Vector3 gravity = physics_gravity * dt;
+    __m128 gx = _mm_set1_ps(gravity.x);
+    __m128 gy = _mm_set1_ps(gravity.y);
+    __m128 gz = _mm_set1_ps(gravity.z);
+    __m128 dt4 = _mm_set1_ps(dt);
+    __m128 damping4 = _mm_set1_ps(damping);
+
+    for(int i = 0; i < wide_count; i += 4)
+    {
+        __m128 awake = flag_clear_x4(flags + i, BODY_SLEEPING);
+        __m128 spinning = _mm_and_ps(awake, flag_clear_x4(flags + i, BODY_FREEZE_ORIENTATION));
+
+        __m128 im = _mm_loadu_ps(inverse_mass + i);
+        __m128 dynamic = _mm_cmpgt_ps(im, _mm_setzero_ps());
+
+        __m128 vx, vy, vz, fx, fy, fz;
+        load_vector3_x4(velocity + i, &vx, &vy, &vz);
+        load_vector3_x4(force + i, &fx, &fy, &fz);
+
+        __m128 nx = _mm_add_ps(vx, _mm_and_ps(dynamic, gx));
+        __m128 ny = _mm_add_ps(vy, _mm_and_ps(dynamic, gy));
+        __m128 nz = _mm_add_ps(vz, _mm_and_ps(dynamic, gz));
+        nx = _mm_add_ps(nx, _mm_mul_ps(_mm_mul_ps(fx, im), dt4));
+        ny = _mm_add_ps(ny, _mm_mul_ps(_mm_mul_ps(fy, im), dt4));
+        nz = _mm_add_ps(nz, _mm_mul_ps(_mm_mul_ps(fz, im), dt4));
+        nx = _mm_mul_ps(nx, damping4);
+
+        store_vector3_x4(velocity + i, select_x4(awake, nx, vx), select_x4(awake, ny, vy), select_x4(awake, nz, vz));
+
+#ifdef PHYSICS_3D
+        __m128 wx, wy, wz, tx, ty, tz;
+        load_vector3_x4(angular_velocity + i, &wx, &wy, &wz);
+        load_vector3_x4(torque + i, &tx, &ty, &tz);
+
+        //NOTE: Mat3 * Vector3 multiplies by the transpose
+        Mat3* m = inverse_inertia + i;
+        __m128 m11 = _mm_set_ps(m[3]._11, m[2]._11, m[1]._11, m[0]._11);
+        __m128 m12 = _mm_set_ps(m[3]._12, m[2]._12, m[1]._12, m[0]._12);
+        __m128 m13 = _mm_set_ps(m[3]._13, m[2]._13, m[1]._13, m[0]._13);
+        __m128 m21 = _mm_set_ps(m[3]._21, m[2]._21, m[1]._21, m[0]._21);
+        __m128 m22 = _mm_set_ps(m[3]._22, m[2]._22, m[1]._22, m[0]._22);
+        __m128 m23 = _mm_set_ps(m[3]._23, m[2]._23, m[1]._23, m[0]._23);
+        __m128 m31 = _mm_set_ps(m[3]._31, m[2]._31, m[1]._31, m[0]._31);
+        __m128 m32 = _mm_set_ps(m[3]._32, m[2]._32, m[1]._32, m[0]._32);
+        __m128 m33 = _mm_set_ps(m[3]._33, m[2]._33, m[1]._33, m[0]._33);
+
+        __m128 ax = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m11, tx), _mm_mul_ps(m21, ty)), _mm_mul_ps(m31, tz));
+        __m128 ay = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m12, tx), _mm_mul_ps(m22, ty)), _mm_mul_ps(m32, tz));
+        __m128 az = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m13, tx), _mm_mul_ps(m23, ty)), _mm_mul_ps(m33, tz));
+
+        __m128 nwx = _mm_mul_ps(_mm_add_ps(wx, _mm_mul_ps(ax, dt4)), damping4);
+        __m128 nwy = _mm_mul_ps(_mm_add_ps(wy, _mm_mul_ps(ay, dt4)), damping4);
+        __m128 nwz = _mm_mul_ps(_mm_add_ps(wz, _mm_mul_ps(az, dt4)), damping4);
+
+        store_vector3_x4(angular_velocity + i, select_x4(spinning, nwx, wx), select_x4(spinning, nwy, wy), select_x4(spinning, nwz, wz));
+#else
+        __m128 w = _mm_loadu_ps(angular_velocity + i);
+        __m128 t = _mm_loadu_ps(torque + i);
+        __m128 ii = _mm_loadu_ps(inverse_inertia + i);
+        __m128 nw = _mm_mul_ps(_mm_add_ps(w, _mm_mul_ps(_mm_mul_ps(ii, t), dt4)), damping4);
+        _mm_storeu_ps(angular_velocity + i, select_x4(spinning, nw, w));
+#endif
+    }
+
+    integrate_velocity_scalar(store, wide_count, store->count, dt, damping);
+}
+
+void integrate_position_sse(BodyStore* store, float dt)
+{
+    int wide_count = store->count & ~3;
+
+    Vector3* position = store->position.data();
+    Vector3* velocity = store->velocity.data();
+    Angular* angular_velocity = store->angular_velocity.data();
+    Rotation* orientation = store->orientation.data();
+    u32* flags = store->flags.data();
+
+    __m128 dt4 = _mm_set1_ps(dt);
+    __m128 one = _mm_set1_ps(1.0f);
+#ifdef PHYSICS_3D
+    __m128 half = _mm_set1_ps(0.5f);
+    __m128 zero = _mm_setzero_ps();
+#endif
+
+    for(int i = 0; i < wide_count; i += 4)
+    {
+        __m128 awake = flag_clear_x4(flags + i, BODY_SLEEPING);
+        __m128 spinning = _mm_and_ps(awake, flag_clear_x4(flags + i, BODY_FREEZE_ORIENTATION));
+
+        __m128 px, py, pz, vx, vy, vz;
+        load_vector3_x4(position + i, &px, &py, &pz);
+        load_vector3_x4(velocity + i, &vx, &vy, &vz);
+
+        __m128 npx = _mm_add_ps(px, _mm_mul_ps(vx, dt4));
+        __m128 npy = _mm_add_ps(py, _mm_mul_ps(vy, dt4));
+        __m128 npz = _mm_add_ps(pz, _mm_mul_ps(vz, dt4));
+        store_vector3_x4(position + i, select_x4(awake, npx, px), select_x4(awake, npy, py), select_x4(awake, npz, pz));
+
+#ifdef PHYSICS_3D
+        //NOTE: rotate_orientation, q + (angle * 0.5, 0) * q then normalize
+        __m128 ax, ay, az;
+        load_vector3_x4(angular_velocity + i, &ax, &ay, &az);
+        ax = _mm_mul_ps(_mm_mul_ps(ax, dt4), half);
+        ay = _mm_mul_ps(_mm_mul_ps(ay, dt4), half);
+        az = _mm_mul_ps(_mm_mul_ps(az, dt4), half);
+
+        float* q = (float*)(orientation + i);
+        __m128 qx = _mm_loadu_ps(q);
+        __m128 qy = _mm_loadu_ps(q + 4);
+        __m128 qz = _mm_loadu_ps(q + 8);
+        __m128 qw = _mm_loadu_ps(q + 12);
+        _MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+        __m128 rw = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(zero, qw), _mm_mul_ps(ax, qx)), _mm_mul_ps(ay, qy)), _mm_mul_ps(az, qz));
+        __m128 rx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(zero, qx), _mm_mul_ps(ax, qw)), _mm_mul_ps(ay, qz)), _mm_mul_ps(az, qy));
+        __m128 ry = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(zero, qy), _mm_mul_ps(ay, qw)), _mm_mul_ps(az, qx)), _mm_mul_ps(ax, qz));
+        __m128 rz = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(zero, qz), _mm_mul_ps(az, qw)), _mm_mul_ps(ax, qy)), _mm_mul_ps(ay, qx));
+
+        __m128 nx = _mm_add_ps(qx, rx);
+        __m128 ny = _mm_add_ps(qy, ry);
+        __m128 nz = _mm_add_ps(qz, rz);
+        __m128 nw = _mm_add_ps(qw, rw);
+
+        __m128 length_sq = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)), _mm_mul_ps(nw, nw));
+        __m128 t = _mm_div_ps(one, _mm_sqrt_ps(length_sq));
+        nx = select_x4(spinning, _mm_mul_ps(nx, t), qx);
+        ny = select_x4(spinning, _mm_mul_ps(ny, t), qy);
+        nz = select_x4(spinning, _mm_mul_ps(nz, t), qz);
+        nw = select_x4(spinning, _mm_mul_ps(nw, t), qw);
+
+        _MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+        _mm_storeu_ps(q, nx);
+        _mm_storeu_ps(q + 4, ny);
+        _mm_storeu_ps(q + 8, nz);
+        _mm_storeu_ps(q + 12, nw);
+#else
+        //NOTE: rotate_orientation, (c - a * s, s + a * c) then normalize
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(angular_velocity + i), dt4);
+
+        float* r = (float*)(orientation + i);
+        __m128 r0 = _mm_loadu_ps(r);
+        __m128 r1 = _mm_loadu_ps(r + 4);
+        __m128 c = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 s = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(3, 1, 3, 1));
+
+        __m128 nc = _mm_sub_ps(c, _mm_mul_ps(a, s));
+        __m128 ns = _mm_add_ps(s, _mm_mul_ps(a, c));
+        __m128 t = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(nc, nc), _mm_mul_ps(ns, ns))));
+        nc = select_x4(spinning, _mm_mul_ps(nc, t), c);
+        ns = select_x4(spinning, _mm_mul_ps(ns, t), s);
+
+        _mm_storeu_ps(r, _mm_unpacklo_ps(nc, ns));
+        _mm_storeu_ps(r + 4, _mm_unpackhi_ps(nc, ns));
+#endif
+    }
+
+    integrate_position_scalar(store, wide_count, store->count, dt);
+}
+
+/*  NOTE: 8 Vector3 are 24 floats in three registers a b c, component k of body j is
+    float 3 * j + k. Each component is picked out of a, b and c with a permute and the
+    three are merged with blends, storing runs the same tables backwards.
+*/
+PHYSICS_TARGET_AVX2
+inline __m256 gather_component_x8(__m256 a, __m256 b, __m256 c, int k)
+{
+    static const int index[3][3][8] = {
+        {{0, 3, 6, 0, 0, 0, 0, 0}, {0, 0, 0, 1, 4, 7, 0, 0}, {0, 0, 0, 0, 0, 0, 2, 5}},
+        {{1, 4, 7, 0, 0, 0, 0, 0}, {0, 0, 0, 2, 5, 0, 0, 0}, {0, 0, 0, 0, 0, 0, 3, 6}},
+        {{2, 5, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 3, 6, 0, 0, 0}, {0, 0, 0, 0, 0, 1, 4, 7}},
+    };
+
+    __m256 pa = _mm256_permutevar8x32_ps(a, _mm256_loadu_si256((__m256i*)index[k][0]));
+    __m256 pb = _mm256_permutevar8x32_ps(b, _mm256_loadu_si256((__m256i*)index[k][1]));
+    __m256 pc = _mm256_permutevar8x32_ps(c, _mm256_loadu_si256((__m256i*)index[k][2]));
+
+    switch(k)
+    {
+        case 0: return _mm256_blend_ps(_mm256_blend_ps(pa, pb, 0x38), pc, 0xC0);
+        case 1: return _mm256_blend_ps(_mm256_blend_ps(pa, pb, 0x18), pc, 0xE0);
+        default: return _mm256_blend_ps(_mm256_blend_ps(pa, pb, 0x1C), pc, 0xE0);
+    }
+}
+
+PHYSICS_TARGET_AVX2
+inline void load_vector3_x8(Vector3* v, __m256* x, __m256* y, __m256* z)
+{
+    float* f = (float*)v;
+    __m256 a = _mm256_loadu_ps(f);
+    __m256 b = _mm256_loadu_ps(f + 8);
+    __m256 c = _mm256_loadu_ps(f + 16);
+
+    *x = gather_component_x8(a, b, c, 0);
+    *y = gather_component_x8(a, b, c, 1);
+    *z = gather_component_x8(a, b, c, 2);
+}
+
+//NOTE: Float r of output register o is component (3 * (8 * o + r)) % 3 of body (8 * o + r) / 3
+PHYSICS_TARGET_AVX2
+inline void store_vector3_x8(Vector3* v, __m256 x, __m256 y, __m256 z)
+{
+    static const int index[3][3][8] = {
+        {{0, 0, 0, 1, 0, 0, 2, 0}, {0, 0, 0, 0, 1, 0, 0, 2}, {0, 0, 0, 0, 0, 1, 0, 0}},
+        {{0, 3, 0, 0, 4, 0, 0, 5}, {0, 0, 3, 0, 0, 4, 0, 0}, {2, 0, 0, 3, 0, 0, 4, 0}},
+        {{0, 0, 6, 0, 0, 7, 0, 0}, {5, 0, 0, 6, 0, 0, 7, 0}, {0, 5, 0, 0, 6, 0, 0, 7}},
+    };
+    static const int blend_y[3] = {0x92, 0x24, 0x49};
+    static const int blend_z[3] = {0x24, 0x49, 0x92};
+
+    float* f = (float*)v;
+    for(int o = 0; o < 3; ++o)
+    {
+        __m256 px = _mm256_permutevar8x32_ps(x, _mm256_loadu_si256((__m256i*)index[o][0]));
+        __m256 py = _mm256_permutevar8x32_ps(y, _mm256_loadu_si256((__m256i*)index[o][1]));
+        __m256 pz = _mm256_permutevar8x32_ps(z, _mm256_loadu_si256((__m256i*)index[o][2]));
+
+        __m256 mask_y = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(blend_y[o]), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)));
+        __m256 mask_z = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(blend_z[o]), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)), _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128)));
+
+        __m256 out = _mm256_blendv_ps(_mm256_blendv_ps(px, py, mask_y), pz, mask_z);
+        _mm256_storeu_ps(f + 8 * o, out);
+    }
+}
+
+PHYSICS_TARGET_AVX2
+inline __m256 flag_clear_x8(u32* flags, u32 flag)
+{
+    __m256i f = _mm256_loadu_si256((__m256i*)flags);
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(f, _mm256_set1_epi32((int)flag)), _mm256_setzero_si256()));
+}
+
+#ifdef PHYSICS_3D
+//NOTE: Quaternions are 4 floats, the in lane 4x4 transpose leaves bodies in 0 2 4 6 1 3 5 7 order
+PHYSICS_TARGET_AVX2
+inline void transpose_quaternion_x8(__m256* r0, __m256* r1, __m256* r2, __m256* r3)
+{
+    __m256 t0 = _mm256_unpacklo_ps(*r0, *r1);
+    __m256 t1 = _mm256_unpackhi_ps(*r0, *r1);
+    __m256 t2 = _mm256_unpacklo_ps(*r2, *r3);
+    __m256 t3 = _mm256_unpackhi_ps(*r2, *r3);
+    *r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    *r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    *r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    *r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+#else
+//NOTE: The in lane shuffle leaves bodies in 0 1 4 5 2 3 6 7 order, swapping the middle
+//      64 bit blocks puts them back. The swap is its own inverse
+PHYSICS_TARGET_AVX2
+inline __m256 swap_middle_x8(__m256 v)
+{
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(v), _MM_SHUFFLE(3, 1, 2, 0)));
+}
+#endif
+
+PHYSICS_TARGET_AVX2
+void integrate_velocity_avx2(BodyStore* store, float dt, float damping)
+{
+    int wide_count = store->count & ~7;
+
+    Vector3* velocity = store->velocity.data();
+    Angular* angular_velocity = store->angular_velocity.data();
+    Vector3* force = store->force.data();
+    Angular* torque = store->torque.data();
+    float* inverse_mass = store->inverse_mass.data();
+    float* inverse_inertia = (float*)store->inverse_inertia.data();
+    u32* flags = store->flags.data();
+
+    Vector3 gravity = physics_gravity * dt;
+    __m256 gx = _mm256_set1_ps(gravity.x);
+    __m256 gy = _mm256_set1_ps(gravity.y);
+    __m256 gz = _mm256_set1_ps(gravity.z);
+    __m256 dt8 = _mm256_set1_ps(dt);
+    __m256 damping8 = _mm256_set1_ps(damping);
+#ifdef PHYSICS_3D
+    __m256i mat3_stride = _mm256_setr_epi32(0, 9, 18, 27, 36, 45, 54, 63);
+#endif
+
+    for(int i = 0; i < wide_count; i += 8)
+    {
+        __m256 awake = flag_clear_x8(flags + i, BODY_SLEEPING);
+        __m256 spinning = _mm256_and_ps(awake, flag_clear_x8(flags + i, BODY_FREEZE_ORIENTATION));
+
+        __m256 im = _mm256_loadu_ps(inverse_mass + i);
+        __m256 dynamic = _mm256_cmp_ps(im, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+        __m256 vx, vy, vz, fx, fy, fz;
+        load_vector3_x8(velocity + i, &vx, &vy, &vz);
+        load_vector3_x8(force + i, &fx, &fy, &fz);
+
+        __m256 nx = _mm256_add_ps(vx, _mm256_and_ps(dynamic, gx));
+        __m256 ny = _mm256_add_ps(vy, _mm256_and_ps(dynamic, gy));
+        __m256 nz = _mm256_add_ps(vz, _mm256_and_ps(dynamic, gz));
+        nx = _mm256_add_ps(nx, _mm256_mul_ps(_mm256_mul_ps(fx, im), dt8));
+        ny = _mm256_add_ps(ny, _mm256_mul_ps(_mm256_mul_ps(fy, im), dt8));
+        nz = _mm256_add_ps(nz, _mm256_mul_ps(_mm256_mul_ps(fz, im), dt8));
+        nx = _mm256_mul_ps(nx, damping8);
+
+        store_vector3_x8(velocity + i, _mm256_blendv_ps(vx, nx, awake), _mm256_blendv_ps(vy, ny, awake), _mm256_blendv_ps(vz, nz, awake));
+
+#ifdef PHYSICS_3D
+        __m256 wx, wy, wz, tx, ty, tz;
+        load_vector3_x8(angular_velocity + i, &wx, &wy, &wz);
+        load_vector3_x8(torque + i, &tx, &ty, &tz);
+
+        //NOTE: Mat3 * Vector3 multiplies by the transpose, m[k] is element k of the 8 matrices
+        float* base = inverse_inertia + i * 9;
+        __m256 m[9];
+        for(int k = 0; k < 9; ++k)
+        {
+            m[k] = _mm256_i32gather_ps(base + k, mat3_stride, 4);
+        }
+
+        __m256 ax = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[0], tx), _mm256_mul_ps(m[3], ty)), _mm256_mul_ps(m[6], tz));
+        __m256 ay = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[1], tx), _mm256_mul_ps(m[4], ty)), _mm256_mul_ps(m[7], tz));
+        __m256 az = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[2], tx), _mm256_mul_ps(m[5], ty)), _mm256_mul_ps(m[8], tz));
+
+        __m256 nwx = _mm256_mul_ps(_mm256_add_ps(wx, _mm256_mul_ps(ax, dt8)), damping8);
+        __m256 nwy = _mm256_mul_ps(_mm256_add_ps(wy, _mm256_mul_ps(ay, dt8)), damping8);
+        __m256 nwz = _mm256_mul_ps(_mm256_add_ps(wz, _mm256_mul_ps(az, dt8)), damping8);
+
+        store_vector3_x8(angular_velocity + i, _mm256_blendv_ps(wx, nwx, spinning), _mm256_blendv_ps(wy, nwy, spinning), _mm256_blendv_ps(wz, nwz, spinning));
+#else
+        __m256 w = _mm256_loadu_ps(angular_velocity + i);
+        __m256 t = _mm256_loadu_ps(torque + i);
+        __m256 ii = _mm256_loadu_ps(inverse_inertia + i);
+        __m256 nw = _mm256_mul_ps(_mm256_add_ps(w, _mm256_mul_ps(_mm256_mul_ps(ii, t), dt8)), damping8);
+        _mm256_storeu_ps(angular_velocity + i, _mm256_blendv_ps(w, nw, spinning));
+#endif
+    }
+
+    integrate_velocity_scalar(store, wide_count, store->count, dt, damping);
+}
+
+PHYSICS_TARGET_AVX2
+void integrate_position_avx2(BodyStore* store, float dt)
+{
+    int wide_count = store->count & ~7;
+
+    Vector3* position = store->position.data();
+    Vector3* velocity = store->velocity.data();
+    Angular* angular_velocity = store->angular_velocity.data();
+    Rotation* orientation = store->orientation.data();
+    u32* flags = store->flags.data();
+
+    __m256 dt8 = _mm256_set1_ps(dt);
+    __m256 one = _mm256_set1_ps(1.0f);
+#ifdef PHYSICS_3D
+    __m256 half = _mm256_set1_ps(0.5f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256i to_transposed = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+#endif
+
+    for(int i = 0; i < wide_count; i += 8)
+    {
+        __m256 awake = flag_clear_x8(flags + i, BODY_SLEEPING);
+        __m256 spinning = _mm256_and_ps(awake, flag_clear_x8(flags + i, BODY_FREEZE_ORIENTATION));
+
+        __m256 px, py, pz, vx, vy, vz;
+        load_vector3_x8(position + i, &px, &py, &pz);
+        load_vector3_x8(velocity + i, &vx, &vy, &vz);
+
+        __m256 npx = _mm256_add_ps(px, _mm256_mul_ps(vx, dt8));
+        __m256 npy = _mm256_add_ps(py, _mm256_mul_ps(vy, dt8));
+        __m256 npz = _mm256_add_ps(pz, _mm256_mul_ps(vz, dt8));
+        store_vector3_x8(position + i, _mm256_blendv_ps(px, npx, awake), _mm256_blendv_ps(py, npy, awake), _mm256_blendv_ps(pz, npz, awake));
+
+#ifdef PHYSICS_3D
+        //NOTE: Work in the transposed body order so the quaternions don't need a permute
+        spinning = _mm256_permutevar8x32_ps(spinning, to_transposed);
+
+        __m256 ax, ay, az;
+        load_vector3_x8(angular_velocity + i, &ax, &ay, &az);
+        ax = _mm256_permutevar8x32_ps(_mm256_mul_ps(_mm256_mul_ps(ax, dt8), half), to_transposed);
+        ay = _mm256_permutevar8x32_ps(_mm256_mul_ps(_mm256_mul_ps(ay, dt8), half), to_transposed);
+        az = _mm256_permutevar8x32_ps(_mm256_mul_ps(_mm256_mul_ps(az, dt8), half), to_transposed);
+
+        float* q = (float*)(orientation + i);
+        __m256 qx = _mm256_loadu_ps(q);
+        __m256 qy = _mm256_loadu_ps(q + 8);
+        __m256 qz = _mm256_loadu_ps(q + 16);
+        __m256 qw = _mm256_loadu_ps(q + 24);
+        transpose_quaternion_x8(&qx, &qy, &qz, &qw);
+
+        __m256 rw = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_mul_ps(zero, qw), _mm256_mul_ps(ax, qx)), _mm256_mul_ps(ay, qy)), _mm256_mul_ps(az, qz));
+        __m256 rx = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(zero, qx), _mm256_mul_ps(ax, qw)), _mm256_mul_ps(ay, qz)), _mm256_mul_ps(az, qy));
+        __m256 ry = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(zero, qy), _mm256_mul_ps(ay, qw)), _mm256_mul_ps(az, qx)), _mm256_mul_ps(ax, qz));
+        __m256 rz = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(zero, qz), _mm256_mul_ps(az, qw)), _mm256_mul_ps(ax, qy)), _mm256_mul_ps(ay, qx));
+
+        __m256 nx = _mm256_add_ps(qx, rx);
+        __m256 ny = _mm256_add_ps(qy, ry);
+        __m256 nz = _mm256_add_ps(qz, rz);
+        __m256 nw = _mm256_add_ps(qw, rw);
+
+        __m256 length_sq = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)), _mm256_mul_ps(nw, nw));
+        __m256 t = _mm256_div_ps(one, _mm256_sqrt_ps(length_sq));
+        nx = _mm256_blendv_ps(qx, _mm256_mul_ps(nx, t), spinning);
+        ny = _mm256_blendv_ps(qy, _mm256_mul_ps(ny, t), spinning);
+        nz = _mm256_blendv_ps(qz, _mm256_mul_ps(nz, t), spinning);
+        nw = _mm256_blendv_ps(qw, _mm256_mul_ps(nw, t), spinning);
+
+        transpose_quaternion_x8(&nx, &ny, &nz, &nw);
+        _mm256_storeu_ps(q, nx);
+        _mm256_storeu_ps(q + 8, ny);
+        _mm256_storeu_ps(q + 16, nz);
+        _mm256_storeu_ps(q + 24, nw);
+#else
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(angular_velocity + i), dt8);
+
+        float* r = (float*)(orientation + i);
+        __m256 r0 = _mm256_loadu_ps(r);
+        __m256 r1 = _mm256_loadu_ps(r + 8);
+        __m256 c = swap_middle_x8(_mm256_shuffle_ps(r0, r1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256 s = swap_middle_x8(_mm256_shuffle_ps(r0, r1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+        __m256 nc = _mm256_sub_ps(c, _mm256_mul_ps(a, s));
+        __m256 ns = _mm256_add_ps(s, _mm256_mul_ps(a, c));
+        __m256 t = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(nc, nc), _mm256_mul_ps(ns, ns))));
+        nc = swap_middle_x8(_mm256_blendv_ps(c, _mm256_mul_ps(nc, t), spinning));
+        ns = swap_middle_x8(_mm256_blendv_ps(s, _mm256_mul_ps(ns, t), spinning));
+
+        _mm256_storeu_ps(r, _mm256_unpacklo_ps(nc, ns));
+        _mm256_storeu_ps(r + 8, _mm256_unpackhi_ps(nc, ns));
+#endif
+    }
+
+    integrate_position_scalar(store, wide_count, store->count, dt);
+}
+
+inline u64 read_xcr0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    u32 eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((u64)edx << 32) | eax;
+#endif
+}
+
+inline void read_cpuid(int leaf, int subleaf, u32 regs[4])
+{
+#if defined(_MSC_VER)
+    __cpuidex((int*)regs, leaf, subleaf);
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+#endif
+
+//NOTE: Widest path this cpu and OS support
+IntegratorPath get_supported_integrator_path()
+{
+#ifdef PHYSICS_X86
+    u32 regs[4];
+    read_cpuid(0, 0, regs);
+    u32 max_leaf = regs[0];
+
+    read_cpuid(1, 0, regs);
+    bool sse2 = (regs[3] & (1u << 26)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    bool avx = (regs[2] & (1u << 28)) != 0;
+
+    if(max_leaf >= 7 && osxsave && avx && (read_xcr0() & 6) == 6)
+    {
+        read_cpuid(7, 0, regs);
+        if(regs[1] & (1u << 5)) return INTEGRATOR_AVX2;
+    }
+    if(sse2) return INTEGRATOR_SSE;
+#endif
+    return INTEGRATOR_SCALAR;
+}
+
+void integrate_velocity(BodyStore* store, IntegratorPath path, float dt, float damping)
+{
+    switch(path)
+    {
+#ifdef PHYSICS_X86
+        case IntegratorPath::INTEGRATOR_AVX2:
+        {
+            integrate_velocity_avx2(store, dt, damping);
+        } break;
+        case IntegratorPath::INTEGRATOR_SSE:
+        {
+            integrate_velocity_sse(store, dt, damping);
+        } break;
+#endif
+        default:
+        {
+            integrate_velocity_scalar(store, 0, store->count, dt, damping);
+        } break;
+    }
+}
+
+void integrate_position(BodyStore* store, IntegratorPath path, float dt)
+{
+    switch(path)
+    {
+#ifdef PHYSICS_X86
+        case IntegratorPath::INTEGRATOR_AVX2:
+        {
+            integrate_position_avx2(store, dt);
+        } break;
+        case IntegratorPath::INTEGRATOR_SSE:
+        {
+            integrate_position_sse(store, dt);
+        } break;
+#endif
+        default:
+        {
+            integrate_position_scalar(store, 0, store->count, dt);
+        } break;
+    }
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+/*  NOTE: Minimal fork/join pool for the physics step.
+    parallel_for hands out job indices from an atomic counter, the calling thread
+    works on jobs too and returns once every job is finished. Without worker
+    threads the jobs simply run in order on the caller.
+*/
+
+struct ThreadPool
+{
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    std::condition_variable done_condition;
+
+    std::function<void(int)> job;
+    int job_count;
+    std::atomic<int> next_job;
+
+    int busy_workers;
+    u64 generation;
+    bool quit;
+};
+
+void run_jobs(ThreadPool* pool)
+{
+    int index;
+    while((index = pool->next_job.fetch_add(1)) < pool->job_count)
+    {
+        pool->job(index);
+    }
+}
+
+void worker_loop(ThreadPool* pool)
+{
+    u64 seen_generation = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            while(!pool->quit && pool->generation == seen_generation)
+            {
+                pool->start_condition.wait(lock);
+            }
+            if(pool->quit) return;
+            seen_generation = pool->generation;
+        }
+
+        run_jobs(pool);
+
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            if(--pool->busy_workers == 0)
+            {
+                pool->done_condition.notify_one();
+            }
+        }
+    }
+}
+
+void destroy_thread_pool(ThreadPool* pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->quit = true;
+    }
+    pool->start_condition.notify_all();
+
+    for(std::thread& t : pool->threads)
+    {
+        t.join();
+    }
+    pool->threads.clear();
+}
+
+//NOTE: worker_count doesn't include the calling thread, 0 runs everything inline
+void init_thread_pool(ThreadPool* pool, int worker_count)
+{
+    destroy_thread_pool(pool);
+
+    pool->quit = false;
+    pool->generation = 0;
+    pool->busy_workers = 0;
+    pool->job_count = 0;
+    pool->next_job = 0;
+
+    for(int i = 0; i < worker_count; ++i)
+    {
+        pool->threads.push_back(std::thread(worker_loop, pool));
+    }
+}
+
+inline int get_thread_count(ThreadPool* pool)
+{
+    return (int)pool->threads.size() + 1;
+}
+
+void parallel_for(ThreadPool* pool, int job_count, std::function<void(int)> job)
+{
+    if(pool->threads.empty() || job_count <= 1)
+    {
+        for(int i = 0; i < job_count; ++i)
+        {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->job = job;
+        pool->job_count = job_count;
+        pool->next_job = 0;
+        pool->busy_workers = (int)pool->threads.size();
+        ++pool->generation;
+    }
+    pool->start_condition.notify_all();
+
+    run_jobs(pool);
+
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    while(pool->busy_workers > 0)
+    {
+        pool->done_condition.wait(lock);
+    }
+}
+
+#endif
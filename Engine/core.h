@@ -3,12 +3,14 @@
 
 #include <fstream>
 #include <vector>
+#include <algorithm>
 #include <map>
 #include <string>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 
+typedef uint8_t u8;
 typedef uint32_t u32;
 typedef uint64_t u64;
 typedef int s32;
@@ -0,0 +1,153 @@
+#ifndef ROTATION_H
+#define ROTATION_H
+
+#include "math.h"
+
+/*  NOTE: Body rotation types
+    The physics is 2D, so by default a body turns about z only: the rotation is a
+    cos/sin pair, and angular velocity, torque and inverse inertia are plain floats.
+    Define PHYSICS_3D before including the engine to get the old Quaternion / Vector3 /
+    Mat3 representation back. Code that has to work with both goes through the
+    helpers below instead of touching the types directly.
+
+    Both keep the convention update_shape always had: a positive angle turns the shape
+    clockwise, so a local vector v ends up at (c * x + s * y, -s * x + c * y) and the
+    velocity of a point r away from the center is v + r x w.
+*/
+
+#ifdef PHYSICS_3D
+
+typedef Quaternion Rotation;
+typedef Vector3 Angular;
+typedef Mat3 InverseInertia;
+
+inline Rotation make_rotation(float angle)
+{
+    return make_quaternion(V3(0, 0, sinf(angle * 0.5f)), cosf(angle * 0.5f));
+}
+
+inline Angular make_angular(float z)
+{
+    return V3(0, 0, z);
+}
+
+inline Angular cross_angular(Vector3 a, Vector3 b)
+{
+    return cross(a, b);
+}
+
+inline float dot_angular(Angular a, Angular b)
+{
+    return dot(a, b);
+}
+
+inline float angular_speed(Angular w)
+{
+    return length(w);
+}
+
+inline Quaternion to_quaternion(Rotation q)
+{
+    return q;
+}
+
+//NOTE: Rotation update_shape applies to the vertices, to_mat4 is used as M * v there
+//      while Mat3 * Vector3 multiplies by the transpose
+Vector3 rotate_to_world(Quaternion q, Vector3 v)
+{
+    Mat3 m = transpose(to_mat3(q));
+    return m * v;
+}
+
+Vector3 rotate_to_local(Quaternion q, Vector3 v)
+{
+    Mat3 m = to_mat3(q);
+    return m * v;
+}
+
+//NOTE: Turns q by the rotation vector angle, first order and renormalized
+inline Quaternion rotate_orientation(Quaternion q, Vector3 angle)
+{
+    return normalize(q + make_quaternion(angle * 0.5f, 0) * q);
+}
+
+#else
+
+struct Rotation
+{
+    float c;
+    float s;
+};
+
+typedef float Angular;
+typedef float InverseInertia;
+
+inline Rotation make_rotation(float angle)
+{
+    Rotation r = {cosf(angle), sinf(angle)};
+    return r;
+}
+
+inline Angular make_angular(float z)
+{
+    return z;
+}
+
+//NOTE: z of the 3D cross product, the only part that is left in the plane
+inline Angular cross_angular(Vector3 a, Vector3 b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+inline float dot_angular(Angular a, Angular b)
+{
+    return a * b;
+}
+
+inline float angular_speed(Angular w)
+{
+    return fabsf(w);
+}
+
+//NOTE: r x (0, 0, w) and (0, 0, w) x r
+inline Vector3 cross(Vector3 r, Angular w)
+{
+    return V3(r.y * w, -r.x * w, 0);
+}
+
+inline Vector3 cross(Angular w, Vector3 r)
+{
+    return V3(-w * r.y, w * r.x, 0);
+}
+
+//NOTE: Only used to hand the rotation to the renderer
+inline Quaternion to_quaternion(Rotation r)
+{
+    float half = atan2f(r.s, r.c) * 0.5f;
+    return make_quaternion(V3(0, 0, sinf(half)), cosf(half));
+}
+
+inline Vector3 rotate_to_world(Rotation r, Vector3 v)
+{
+    return V3(r.c * v.x + r.s * v.y, -r.s * v.x + r.c * v.y, v.z);
+}
+
+inline Vector3 rotate_to_local(Rotation r, Vector3 v)
+{
+    return V3(r.c * v.x - r.s * v.y, r.s * v.x + r.c * v.y, v.z);
+}
+
+//NOTE: Turns r by angle, first order and renormalized, the 2D version of the quaternion update
+inline Rotation rotate_orientation(Rotation r, float angle)
+{
+    float c = r.c - angle * r.s;
+    float s = r.s + angle * r.c;
+    float t = 1.0f / sqrtf(c * c + s * s);
+
+    Rotation result = {c * t, s * t};
+    return result;
+}
+
+#endif
+
+#endif
@@ -3,6 +3,7 @@
 
 //#include <math.h>
 #include "math.h"
+#include "rotation.h"
 
 enum ShapeType
 {
@@ -11,25 +12,74 @@ enum ShapeType
     RIGHT_TRIANGLE,
     CIRCLE,
     CUSTOM,
+
+    SHAPE_TYPE_COUNT,
 };
 
+#define SHAPE_MAX_VERTICES 8
+#define SHAPE_MAX_PROTOTYPES 64
+
+/*  NOTE: Shape prototypes
+    The unit polygon of a shape, shared by every shape made from it and never changed once
+    registered. The built in types are registered on first use and live forever, CUSTOM
+    shapes register their own and the slot is freed when the last shape using it is
+    destroyed. A shape only keeps the handle and its scale (dim).
+*/
+struct ShapePrototype
+{
+    ShapeType type;
+    int vertices_count;
+    Vector3 local_vertices[SHAPE_MAX_VERTICES];
+
+    //NOTE: Outward normal of edge i, vertex i to i + 1
+    Vector3 local_normals[SHAPE_MAX_VERTICES];
+
+    //NOTE: Mean x^2 and y^2 over the area of the unit shape, about its origin. Scaled by
+    //      dim^2 and the mass it gives the moment of inertia, see create_body
+    Vector2 second_moment;
+
+    int ref_count;
+};
+
+static ShapePrototype shape_prototypes[SHAPE_MAX_PROTOTYPES];
+
+struct AABB
+{
+    Vector2 min;
+    Vector2 max;
+};
+
+inline bool aabb_overlap(AABB a, AABB b)
+{
+    return !(b.max.x < a.min.x || a.max.x < b.min.x ||
+             b.max.y < a.min.y || a.max.y < b.min.y);
+}
+
 //NOTE: Y axis positive is up
 struct Shape 
 {
-    Vector3* local_vertices;
-    Vector3* global_vertices;
+    int prototype;
     int vertices_count;
 
+    //NOTE: World space vertices and edge normals, kept current by update_shape. They point
+    //      into the buffers of the world the body belongs to and are 0 until it is added
+    Vector3* global_vertices;
+    Vector3* global_normals;
+
     Vector3 center_pos;
     Vector3 dim;
     
+    //NOTE: World bounds, every update_shape refreshes aabb and radius is the distance from
+    //      center_pos to the furthest vertex
+    AABB aabb;
     float radius;
 
     //float orientation;
     ShapeType type;
 };
 
-Shape create_shape(Vector3 dim, ShapeType type = ShapeType::RECTANGLE, Vector3* vertices = 0);
+Shape create_shape(Vector3 dim, ShapeType type = ShapeType::RECTANGLE, Vector3* vertices = 0, int vertices_count = 0);
+void destroy_shape(Shape* shape);
 
 void reset_shape_vertices(Shape* shape);
 void update_shape(Shape* shape, Vector3 pos, Vector3 dim, Vector3 axis = {}, float angle = 0);
@@ -56,8 +106,14 @@ Vector3 get_furthest_vertex(Shape* shape)
     return shape->global_vertices[index];
 }
 
+//NOTE: The support function GJK uses, a circle's is the point on its rim along dir
 Vector3 get_furthest_point_in_direction(Shape* shape, Vector3 dir)
 {
+    if(shape->type == ShapeType::CIRCLE)
+    {
+        return shape->center_pos + normalize(dir) * shape->radius;
+    }
+
     float max = -FLT_MAX;
     u32 index = 0;
 
@@ -92,14 +148,51 @@ int get_furthest_point_index_in_direction(Shape* shape, Vector3 dir)
     return index;
 }
 
+//NOTE: Walks from start towards whichever neighbour is further along dir until it stops
+//      improving. A convex polygon has a single peak along any direction, so this finds
+//      the support the full scan finds, and from last query's index it is a step or two
+int climb_to_furthest_point_index(Shape* shape, Vector3 dir, int start)
+{
+    int count = shape->vertices_count;
+    if(start < 0 || start >= count)
+    {
+        return get_furthest_point_index_in_direction(shape, dir);
+    }
+
+    Vector3* v = shape->global_vertices;
+    int index = start;
+    float max = dot(v[index], dir);
+
+    int next = index + 1 == count ? 0 : index + 1;
+    bool forward = dot(v[next], dir) > max;
+
+    for(int i = 1; i < count; ++i)
+    {
+        int candidate = forward ? (index + 1 == count ? 0 : index + 1) : (index == 0 ? count - 1 : index - 1);
+        float dot_product = dot(v[candidate], dir);
+        if(!(dot_product > max)) break;
+
+        max = dot_product;
+        index = candidate;
+    }
+
+    return index;
+}
+
+inline ShapePrototype* get_shape_prototype(Shape* shape)
+{
+    return &shape_prototypes[shape->prototype];
+}
+
 int get_furthest_local_point_index_in_direction(Shape* shape, Vector3 dir)
 {
     float max = -FLT_MAX;
     u32 index = 0;
 
+    Vector3* local_vertices = get_shape_prototype(shape)->local_vertices;
     for(int i = 0; i < shape->vertices_count; ++i)
     {
-        float dot_product = dot(shape->local_vertices[i], dir);
+        float dot_product = dot(local_vertices[i], dir);
         if(dot_product > max)
         {
             max = dot_product;
@@ -115,78 +208,214 @@ float get_shape_radius(Shape* shape)
     return length(get_furthest_vertex(shape) - shape->center_pos);
 }
 
-Shape create_shape(Vector3 dim, ShapeType type, Vector3* vertices)
+//NOTE: Vertices are counter clockwise, returns the handle with one reference held by the caller
+int register_shape_prototype(ShapeType type, Vector3* vertices, int vertices_count)
+{
+    assert(vertices_count <= SHAPE_MAX_VERTICES);
+
+    int handle = 0;
+    while(handle < SHAPE_MAX_PROTOTYPES && shape_prototypes[handle].ref_count > 0)
+    {
+        ++handle;
+    }
+    assert(handle < SHAPE_MAX_PROTOTYPES);
+
+    ShapePrototype* prototype = &shape_prototypes[handle];
+    *prototype = {};
+    prototype->type = type;
+    prototype->vertices_count = vertices_count;
+    prototype->ref_count = 1;
+
+    float area = 0;
+    Vector2 moment = {};
+    for(int i = 0; i < vertices_count; ++i)
+    {
+        Vector3 p1 = vertices[i];
+        Vector3 p2 = vertices[i + 1 == vertices_count ? 0 : i + 1];
+        prototype->local_vertices[i] = p1;
+        prototype->local_normals[i] = normalize(V3(cross((p2 - p1).xy, -1)));
+
+        float c = cross(p1.xy, p2.xy);
+        area += c;
+        moment.x += c * (p1.x * p1.x + p1.x * p2.x + p2.x * p2.x);
+        moment.y += c * (p1.y * p1.y + p1.y * p2.y + p2.y * p2.y);
+    }
+
+    //NOTE: Twice the area and the polygon sums of x^2 and y^2 times 12, the ratio is the mean
+    if(area != 0)
+    {
+        prototype->second_moment = moment * (1.0f / (6.0f * area));
+    }
+
+    return handle;
+}
+
+void acquire_shape_prototype(int handle)
+{
+    ++shape_prototypes[handle].ref_count;
+}
+
+void release_shape_prototype(int handle)
 {
+    assert(shape_prototypes[handle].ref_count > 0);
+    --shape_prototypes[handle].ref_count;
+}
+
+//NOTE: Handles of the built in types, registered by the first create_shape
+static int builtin_shape_prototypes[ShapeType::CUSTOM];
+static bool builtin_shape_prototypes_registered = false;
+
+void register_builtin_shape_prototypes()
+{
+    //NOTE: Vertices order start from top left, counter-clockwise
+    Vector3 rectangle[] = {V3(-0.5f, 0.5f, 0), V3(-0.5f, -0.5f, 0), V3(0.5f, -0.5f, 0), V3(0.5f, 0.5f, 0)};
+
+    /* NOTE: Vertices order
+        2
+        *   *
+                *
+        *           *
+                        *
+        *                   1
+                        *
+        *           *
+                *    
+        *   *
+        3 
+    */
+    Vector3 triangle[] = {V3(0.5f, 0, 0), V3(-0.5f, 0.5f, 0), V3(-0.5f, -0.5f, 0)};
+
+    /* NOTE: Vertices order
+        2
+        * *
+        *  *
+        *   *
+        *    *
+        3 * * 1 
+    */
+    Vector3 right_triangle[] = {V3(0.5f, -0.5f, 0), V3(-0.5f, 0.5f, 0), V3(-0.5f, -0.5f, 0)};
+
+    //NOTE: The registry keeps the reference it gets back, so these are never freed
+    builtin_shape_prototypes[ShapeType::RECTANGLE] = register_shape_prototype(ShapeType::RECTANGLE, rectangle, 4);
+    builtin_shape_prototypes[ShapeType::TRIANGLE] = register_shape_prototype(ShapeType::TRIANGLE, triangle, 3);
+    builtin_shape_prototypes[ShapeType::RIGHT_TRIANGLE] = register_shape_prototype(ShapeType::RIGHT_TRIANGLE, right_triangle, 3);
+    //NOTE: Circle of diameter 1, mean x^2 = mean y^2 = r^2 / 4
+    int circle = register_shape_prototype(ShapeType::CIRCLE, 0, 0);
+    shape_prototypes[circle].second_moment = V2(1.0f / 16.0f, 1.0f / 16.0f);
+    builtin_shape_prototypes[ShapeType::CIRCLE] = circle;
+    builtin_shape_prototypes_registered = true;
+}
+
+//NOTE: Recomputes the normals from global_vertices, for the transforms that can shear the shape
+void update_global_normals(Shape* shape)
+{
+    for(int i = 0; i < shape->vertices_count; ++i)
+    {
+        Vector3 p1 = shape->global_vertices[i];
+        Vector3 p2 = shape->global_vertices[i + 1 == shape->vertices_count ? 0 : i + 1];
+
+        Vector3 edge = p2 - p1;
+        Vector3 n = V3(cross(edge.xy, -1));
+        shape->global_normals[i] = normalize(n);
+    }
+}
+
+//NOTE: Doesn't allocate. Copies of the returned shape share its prototype reference, so
+//      destroy_shape is called once for all of them. A world takes its own reference in
+//      add_body, the shape can be destroyed once it's added
+Shape create_shape(Vector3 dim, ShapeType type, Vector3* vertices, int vertices_count)
+{
+    if(!builtin_shape_prototypes_registered)
+    {
+        register_builtin_shape_prototypes();
+    }
+
     Shape shape = {};
     shape.type = type;
     shape.dim = dim;
 
-    switch(shape.type)
+    if(type == ShapeType::CUSTOM)
     {
-        case ShapeType::RECTANGLE:
-        {
-            //NOTE: Vertices order start from top left, counter-clockwise
-            shape.vertices_count = 4;
-            shape.local_vertices = (Vector3*)malloc(sizeof(Vector3) * shape.vertices_count);
-            shape.global_vertices = (Vector3*)malloc(sizeof(Vector3) * shape.vertices_count);
-            shape.local_vertices[0] = V3(-0.5f, 0.5f, 0);
-            shape.local_vertices[1] = V3(-0.5f, -0.5f, 0);
-            shape.local_vertices[2] = V3(0.5f, -0.5f, 0);
-            shape.local_vertices[3] = V3(0.5f, 0.5f, 0);
-        } break;
-        case ShapeType::TRIANGLE:
-        {
-            /* NOTE: Vertices order
-                2
-                *   *
-                        *
-                *           *
-                                *
-                *                   1
-                                *
-                *           *
-                        *    
-                *   *
-                3 
-            */
-            shape.vertices_count = 3;
-            shape.local_vertices = (Vector3*)malloc(sizeof(Vector3) * shape.vertices_count);
-            shape.global_vertices = (Vector3*)malloc(sizeof(Vector3) * shape.vertices_count);
-            shape.local_vertices[0] = V3(0.5f, 0, 0);
-            shape.local_vertices[1] = V3(-0.5f, 0.5f, 0);
-            shape.local_vertices[2] = V3(-0.5f, -0.5f, 0);
-        } break;
-        case ShapeType::RIGHT_TRIANGLE:
-        {
-            /* NOTE: Vertices order
-                2
-                * *
-                *  *
-                *   *
-                *    *
-                3 * * 1 
-            */
-            shape.vertices_count = 3;
-            shape.local_vertices = (Vector3*)malloc(sizeof(Vector3) * shape.vertices_count);
-            shape.global_vertices = (Vector3*)malloc(sizeof(Vector3) * shape.vertices_count);
-            shape.local_vertices[0] = V3(0.5f, -0.5f, 0);
-            shape.local_vertices[1] = V3(-0.5f, 0.5f, 0);
-            shape.local_vertices[2] = V3(-0.5f, -0.5f, 0);
-        } break;
-        case ShapeType::CUSTOM:
-        {
-            shape.local_vertices = vertices;
-            shape.global_vertices = vertices;
-        } break;
+        shape.prototype = register_shape_prototype(type, vertices, vertices_count);
+    }
+    else
+    {
+        shape.prototype = builtin_shape_prototypes[type];
+        acquire_shape_prototype(shape.prototype);
+    }
+
+    ShapePrototype* prototype = get_shape_prototype(&shape);
+    shape.vertices_count = prototype->vertices_count;
+
+    //NOTE: Scaling is all that changes the distance to the center, it holds for any rotation.
+    //      A circle's dim.x is its diameter
+    for(int i = 0; i < shape.vertices_count; ++i)
+    {
+        Vector3 v = prototype->local_vertices[i];
+        shape.radius = max(shape.radius, length(V3(v.x * dim.x, v.y * dim.y, 0)));
+    }
+    if(type == ShapeType::CIRCLE)
+    {
+        shape.radius = dim.x * 0.5f;
     }
 
     return shape;
 }
 
+void destroy_shape(Shape* shape)
+{
+    release_shape_prototype(shape->prototype);
+    shape->global_vertices = 0;
+    shape->global_normals = 0;
+}
+
+//NOTE: A circle's box is its center +- radius, a shape without buffers only has its center
+void update_shape_bounds(Shape* shape)
+{
+    if(shape->type == ShapeType::CIRCLE)
+    {
+        Vector2 r = V2(shape->radius, shape->radius);
+        shape->aabb.min = shape->center_pos.xy - r;
+        shape->aabb.max = shape->center_pos.xy + r;
+        return;
+    }
+
+    if(!shape->global_vertices || !shape->vertices_count)
+    {
+        shape->aabb.min = shape->center_pos.xy;
+        shape->aabb.max = shape->center_pos.xy;
+        return;
+    }
+
+    AABB box;
+    box.min = shape->global_vertices[0].xy;
+    box.max = shape->global_vertices[0].xy;
+    for(int i = 1; i < shape->vertices_count; ++i)
+    {
+        Vector2 v = shape->global_vertices[i].xy;
+        box.min.x = min(box.min.x, v.x);
+        box.min.y = min(box.min.y, v.y);
+        box.max.x = max(box.max.x, v.x);
+        box.max.y = max(box.max.y, v.y);
+    }
+    shape->aabb = box;
+}
+
+//NOTE: Cheap reject before any axis is projected, the bounding circles first then the boxes
+inline bool shape_bounds_overlap(Shape* a, Shape* b)
+{
+    Vector2 d = b->center_pos.xy - a->center_pos.xy;
+    float r = a->radius + b->radius;
+    if(dot(d, d) > r * r) return false;
+
+    return aabb_overlap(a->aabb, b->aabb);
+}
+
 void update_shape(Shape* shape, Vector3 pos, Vector3 dim, Vector3 axis, float angle)
 {
-    if (shape->vertices_count)
+    if(shape->global_vertices)
     {
+        Vector3* local_vertices = get_shape_prototype(shape)->local_vertices;
         Mat4 transform = mat4_identity();
         transform = mat4_scale(transform, dim);
         if(angle) transform = mat4_rotate(transform, axis, angle);
@@ -194,21 +423,25 @@ void update_shape(Shape* shape, Vector3 pos, Vector3 dim, Vector3 axis, float an
 
         for(int i = 0; i < shape->vertices_count; ++i)
         {
-            Vector4 vertex = V4(shape->local_vertices[i], 1);
+            Vector4 vertex = V4(local_vertices[i], 1);
             vertex = transform * vertex;
             shape->global_vertices[i] = {vertex.x, vertex.y, vertex.z};
         }
+        update_global_normals(shape);
+        if(shape->vertices_count) shape->radius = get_shape_radius(shape);
     }
 
-    shape->radius = get_shape_radius(shape);
     shape->center_pos = pos;
     shape->dim = dim;
+    update_shape_bounds(shape);
 }
 
 void update_shape(Shape* shape, Vector3 pos, Quaternion q)
 {
-    if(shape->vertices_count)
+    shape->center_pos = pos;
+    if(shape->global_vertices)
     {
+        Vector3* local_vertices = get_shape_prototype(shape)->local_vertices;
         Mat4 transform = mat4_identity();
         transform = mat4_scale(transform, shape->dim);
         transform = transform * to_mat4(q);
@@ -216,11 +449,56 @@ void update_shape(Shape* shape, Vector3 pos, Quaternion q)
 
         for(int i = 0; i < shape->vertices_count; ++i)
         {
-            Vector4 vertex = V4(shape->local_vertices[i], 1);
+            Vector4 vertex = V4(local_vertices[i], 1);
             vertex = transform * vertex;
             shape->global_vertices[i] = {vertex.x, vertex.y, vertex.z};
         }
+        update_global_normals(shape);
+
+        //NOTE: The rotation can shear a non square shape, so the radius changes with it
+        if(shape->vertices_count) shape->radius = get_shape_radius(shape);
+    }
+    update_shape_bounds(shape);
+}
+
+#ifndef PHYSICS_3D
+//NOTE: 2D version, scales then rotates each vertex with the cos/sin pair, no Mat4 involved.
+//      Unlike the quaternion version above non square shapes keep their right angles.
+//      The normals are the shared local ones rotated, only a slanted edge of a non square
+//      shape has to be rescaled and normalized. A rigid rotation keeps the radius
+//      create_shape computed
+void update_shape(Shape* shape, Vector3 pos, Rotation r)
+{
+    shape->center_pos = pos;
+    if(!shape->global_vertices)
+    {
+        update_shape_bounds(shape);
+        return;
+    }
+
+    ShapePrototype* prototype = get_shape_prototype(shape);
+    Vector3* global = shape->global_vertices;
+    float w = shape->dim.x;
+    float h = shape->dim.y;
+
+    for(int i = 0; i < shape->vertices_count; ++i)
+    {
+        float x = prototype->local_vertices[i].x * w;
+        float y = prototype->local_vertices[i].y * h;
+        global[i] = V3(pos.x + r.c * x + r.s * y, pos.y - r.s * x + r.c * y, pos.z);
+    }
+
+    for(int i = 0; i < shape->vertices_count; ++i)
+    {
+        Vector3 n = prototype->local_normals[i];
+        if(w != h && n.x != 0 && n.y != 0)
+        {
+            n = normalize(V3(n.x * h, n.y * w, 0));
+        }
+        shape->global_normals[i] = V3(r.c * n.x + r.s * n.y, -r.s * n.x + r.c * n.y, 0);
     }
+    update_shape_bounds(shape);
 }
+#endif
 
 #endif 
\ No newline at end of file
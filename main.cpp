@@ -36,10 +36,8 @@ int wmain()
 	// custom_rect_vertices_2[2] = V3(4, 2, 0);
 	// custom_rect_vertices_2[3] = V3(12, 2, 0);
 
-	// Shape test_shape_1 = create_shape({}, ShapeType::CUSTOM, custom_rect_vertices_1);
-	// test_shape_1.vertices_count = 4;
-	// Shape test_shape_2 = create_shape({}, ShapeType::CUSTOM, custom_rect_vertices_2);
-	// test_shape_2.vertices_count = 4;
+	// Shape test_shape_1 = create_shape({1, 1}, ShapeType::CUSTOM, custom_rect_vertices_1, 4);
+	// Shape test_shape_2 = create_shape({1, 1}, ShapeType::CUSTOM, custom_rect_vertices_2, 4);
 
 	// RigidBody test_box_1 = {};
 	// test_box_1.shape = test_shape_1;
@@ -64,38 +62,39 @@ int wmain()
 	wall2.freeze_orientation = true;
 	wall2.friction = 0.5f;
 
-	std::vector<RigidBody> bodies;
-	bodies.push_back(player_body);
-	bodies.push_back(box);
-	bodies.push_back(wall);
-	bodies.push_back(wall2);
+	PhysicsWorld world = {};
+	init_physics_world(&world);
+	set_worker_threads(&world, (int)std::thread::hardware_concurrency() - 1);
+	int player_index = add_body(&world, player_body);
+	int box_index = add_body(&world, box);
+	add_body(&world, wall);
+	add_body(&world, wall2);
+	destroy_shape(&player_body.shape);
+	destroy_shape(&box.shape);
+	destroy_shape(&wall.shape);
+	destroy_shape(&wall2.shape);
 
-	Constraint test_constraint = create_distance_constraint(&player_body, &box, player_body.position + V3(50, 0), box.position + V3(-25, 0));
+	Constraint test_constraint = create_distance_constraint(&world.store, player_index, box_index, player_body.position + V3(50, 0), box.position + V3(-25, 0));
 
 	bool angular_motion = false;
 
-	std::vector<Manifold> manifolds;
-
     while(handle_events())
     {
         gl_clear(V4(0, 0, 0, 1));
-		
-		manifolds.clear();
 
 		if(mouse_ended_down(MOUSE_BUTTON_LEFT))
 		{
 			RigidBody b = create_body(create_shape({50, 50}), V3(get_mouse_position_flipped()), {}, 1);
 			b.color = V4(randf(0, 1.0f), randf(0, 1.0f), randf(0, 1.0f), 1); 
 			b.restitution = 0;
-			//bodies.insert(bodies.begin(), b);
-			bodies.push_back(b);
+			add_body(&world, b);
+			destroy_shape(&b.shape);
 		}
 
-		for(RigidBody& body : bodies)
+		for(int i = 0; i < (int)world.bodies.size(); ++i)
 		{
-			if(body.type == DebugType::PLAYER)
+			if(world.bodies[i].type == DebugType::PLAYER)
 			{
-				body.force = {};
 				Vector3 force = {};
 				float weight = 10000;
 				if(key_down(SDL_SCANCODE_LEFT))
@@ -119,12 +118,15 @@ int wmain()
 					angular_motion = !angular_motion;
 				}
 
-				body.force += normalize(force) * weight;
+				set_body_force(&world, i, normalize(force) * weight);
 
 				if(angular_motion)
-					body.angular_velocity += V3(0, 0, 1) * physics_dt;
+					set_body_angular_velocity(&world, i, get_body_angular_velocity(&world, i) + make_angular(physics_dt));
 				else
-					body.angular_velocity = {};
+					set_body_angular_velocity(&world, i, {});
+
+				if(!(force == V3()) || angular_motion)
+					wake_body(&world, i);
 			}
 		}
 		
@@ -135,48 +137,11 @@ int wmain()
 
 		physics_time_accumlator += frame_time;
 
-		for(int i = 0; i < bodies.size(); ++i)
-		{
-			for(int j = i+1; j < bodies.size(); ++j)
-			{
-				Manifold m = {};
-				if(test_SAT(&bodies[i], &bodies[j], &m))
-				{
-					manifolds.push_back(m);
-				}
-			}
-		}
-
         while(physics_time_accumlator >= physics_dt)
         {	
-			
-			// for(Manifold& m : manifolds)
-			// {
-			// 	for(Contact& c : m.contacts)
-			// 	{
-			// 		update_contact(&m, &c);
-			// 	}
-			// }
-
-			for(RigidBody& body : bodies)
-			{
-				integrate_for_velocity(&body, physics_dt);
-			}
-
-			for(Manifold& m : manifolds)
-			{
-				for(Contact& c : m.contacts)
-				{
-					solve_contact_constraint(&m, &c);
-				}
-			}
+			//apply_impulse(&world.store, &test_constraint, physics_dt);
 
-			//apply_impulse(&test_constraint, physics_dt);
-
-			for(RigidBody& body : bodies)
-			{
-				integrate_for_position(&body, physics_dt);
-			}
+			step_physics_world(&world, physics_dt);
 
             physics_time_accumlator -= physics_dt;
         }
@@ -187,14 +152,15 @@ int wmain()
 		gl_set_mat4(basic_renderer, "Projection", projection);
 		gl_set_mat4(basic_renderer, "View", mat4_identity());
 
-		for(RigidBody& body : bodies)
+		for(int i = 0; i < (int)world.bodies.size(); ++i)
 		{
-			gl_draw(basic_renderer, rect_shape_data, 0, true, body.position, body.shape.dim, body.orientation, body.color);
+			RigidBody* body = &world.bodies[i];
+			gl_draw(basic_renderer, rect_shape_data, 0, true, get_body_position(&world, i), body->shape.dim, to_quaternion(get_body_orientation(&world, i)), body->color);
 		}
 
-		for(Manifold& m : manifolds)
+		for(Manifold& m : world.manifolds)
 		{
-			for(int i = 0; i < m.cp.size(); ++i)
+			for(int i = 0; i < m.contact_count; ++i)
 			{
 				gl_draw(basic_renderer, rect_shape_data, 0, true, m.cp[i], {8,8}, V4(1, 1, 0, 1)); 
 			}
@@ -203,4 +169,6 @@ int wmain()
         SDL_GL_SwapWindow(app_core.graphics.window);
         update_clock(&app_core.clock);
     }
+
+	destroy_physics_world(&world);
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "physics_test.h"
+
+/*  NOTE: Box vs box benchmark
+    Random box pairs, about a third of them touching, run through test_box_box one pair
+    at a time and through the batched axis tests on every path the cpu supports. Reports
+    pairs per second for the axis tests alone and for the full test with the manifold of
+    every pair that hit, the way collide_box_box_batch runs them. 2D only.
+*/
+
+#ifndef PHYSICS_3D
+
+#define BOX_BOX_BENCH_PAIRS 4096
+#define BOX_BOX_BENCH_ROUNDS 200
+
+static Vector3 bench_vertices[BOX_BOX_BENCH_PAIRS * 2][4];
+static Vector3 bench_normals[BOX_BOX_BENCH_PAIRS * 2][4];
+static RigidBody bench_bodies[BOX_BOX_BENCH_PAIRS * 2];
+static BoxBoxLanes bench_lanes;
+
+//NOTE: Pairs per second one pair at a time, hits is the number of pairs that touch
+double bench_box_box_scalar(int* hits)
+{
+    *hits = 0;
+    double start = get_test_time_in_seconds();
+    for(int round = 0; round < BOX_BOX_BENCH_ROUNDS; ++round)
+    {
+        for(int i = 0; i < BOX_BOX_BENCH_PAIRS; ++i)
+        {
+            Manifold m = {};
+            *hits += test_box_box(&bench_bodies[i * 2], &bench_bodies[i * 2 + 1], &m);
+        }
+    }
+    double seconds = get_test_time_in_seconds() - start;
+
+    *hits /= BOX_BOX_BENCH_ROUNDS;
+    return BOX_BOX_BENCH_PAIRS * (double)BOX_BOX_BENCH_ROUNDS / seconds;
+}
+
+//NOTE: Same pairs BOX_BOX_LANES at a time through path, with_manifolds also clips the hits
+double bench_box_box_lanes(IntegratorPath path, bool with_manifolds, int* hits)
+{
+    *hits = 0;
+    double start = get_test_time_in_seconds();
+    for(int round = 0; round < BOX_BOX_BENCH_ROUNDS; ++round)
+    {
+        for(int first = 0; first < BOX_BOX_BENCH_PAIRS; first += BOX_BOX_LANES)
+        {
+            bench_lanes.count = 0;
+            for(int i = first; i < first + BOX_BOX_LANES; ++i)
+            {
+                add_box_box_lane(&bench_lanes, &bench_bodies[i * 2].shape, &bench_bodies[i * 2 + 1].shape);
+            }
+            sat_box_box_lanes(&bench_lanes, path);
+
+            for(int i = 0; i < bench_lanes.count; ++i)
+            {
+                if(bench_lanes.axis[i] < 0) continue;
+                if(with_manifolds)
+                {
+                    Manifold m = {};
+                    set_box_box_lane_manifold(&bench_lanes, i, &bench_bodies[(first + i) * 2], &bench_bodies[(first + i) * 2 + 1], &m);
+                }
+                ++*hits;
+            }
+        }
+    }
+    double seconds = get_test_time_in_seconds() - start;
+
+    *hits /= BOX_BOX_BENCH_ROUNDS;
+    return BOX_BOX_BENCH_PAIRS * (double)BOX_BOX_BENCH_ROUNDS / seconds;
+}
+
+int main()
+{
+    TestRandom random = {1};
+    for(int i = 0; i < BOX_BOX_BENCH_PAIRS * 2; ++i)
+    {
+        bench_bodies[i].shape = create_shape(V3(next_float(&random, 20, 100), next_float(&random, 20, 100)));
+        bench_bodies[i].shape.global_vertices = bench_vertices[i];
+        bench_bodies[i].shape.global_normals = bench_normals[i];
+        update_shape(&bench_bodies[i].shape, V3(next_float(&random, 0, 200), next_float(&random, 0, 200)), make_rotation(next_float(&random, -3, 3)));
+    }
+
+    int hits = 0;
+    double scalar = bench_box_box_scalar(&hits);
+    printf("%d pairs, %d touching\n", BOX_BOX_BENCH_PAIRS, hits);
+    printf("test_box_box        %7.1f Mpairs/s\n", scalar * 1e-6);
+
+    IntegratorPath supported = get_supported_integrator_path();
+    for(int path = INTEGRATOR_SCALAR; path <= supported; ++path)
+    {
+        int axis_hits = 0;
+        int manifold_hits = 0;
+        double axes = bench_box_box_lanes((IntegratorPath)path, false, &axis_hits);
+        double full = bench_box_box_lanes((IntegratorPath)path, true, &manifold_hits);
+        printf("path %d axes only   %7.1f Mpairs/s (%.2fx)\n", path, axes * 1e-6, axes / scalar);
+        printf("path %d with clip   %7.1f Mpairs/s (%.2fx)\n", path, full * 1e-6, full / scalar);
+        if(axis_hits != hits || manifold_hits != hits)
+        {
+            printf("path %d found %d and %d touching pairs\n", path, axis_hits, manifold_hits);
+            return 1;
+        }
+    }
+
+    for(int i = 0; i < BOX_BOX_BENCH_PAIRS * 2; ++i)
+    {
+        destroy_shape(&bench_bodies[i].shape);
+    }
+    return 0;
+}
+
+#else
+
+int main()
+{
+    printf("box vs box batches are 2D only\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,116 @@
+#include "physics_test.h"
+
+/*  NOTE: Broadphase benchmark
+    A grid of boxes falls onto a ground while every broadphase type finds its pairs, next
+    to find_pairs_brute_force on the same boxes. Reports the time of update_pairs alone,
+    of the whole step_physics_world and the pairs the narrowphase tested per frame.
+    Every BROADPHASE_BENCH_CHECK_EVERY frames the pairs are checked against the brute force
+    ones: sweep and prune and the grid have to find exactly the same pairs, the tree works
+    on fattened boxes and has to find at least all of them. The brute force takes seconds
+    per frame above BROADPHASE_BENCH_BRUTE_FORCE_MAX bodies and is skipped there.
+    Returns non zero when a broadphase misses a pair.
+*/
+
+#define BROADPHASE_BENCH_FRAMES 100
+#define BROADPHASE_BENCH_CHECK_EVERY 25
+#define BROADPHASE_BENCH_BRUTE_FORCE_MAX 10000
+
+void add_box_grid(PhysicsWorld* world, int count)
+{
+    TestRandom random = {1};
+    int side = (int)sqrtf((float)count);
+
+    Shape ground = create_shape(V3(60.0f * side + 200, 100));
+    add_body(world, create_body(ground, V3(30.0f * side, -100), {}, 0));
+    destroy_shape(&ground);
+
+    Shape box = create_shape(V3(50, 50));
+    for(int i = 0; i < count; ++i)
+    {
+        Vector3 p = V3((i % side) * 52.0f + next_float(&random, 0, 4), (i / side) * 52.0f + next_float(&random, 0, 4));
+        add_body(world, create_body(box, p, {}, 1));
+    }
+    destroy_shape(&box);
+}
+
+//NOTE: True when every pair of expected is in pairs, both sorted
+bool contains_pairs(std::vector<BroadphasePair>* pairs, std::vector<BroadphasePair>* expected)
+{
+    return std::includes(pairs->begin(), pairs->end(), expected->begin(), expected->end(), pair_less);
+}
+
+int main()
+{
+    const char* names[] = {"aabb tree", "sweep and prune", "uniform grid"};
+    int counts[] = {1000, 10000, 50000};
+
+    bool ok = true;
+    std::vector<AABB> boxes;
+    std::vector<BroadphasePair> expected;
+    for(int c = 0; c < (int)ARRAY_SIZE(counts); ++c)
+    {
+        bool brute_force_checked = counts[c] <= BROADPHASE_BENCH_BRUTE_FORCE_MAX;
+        for(int type = AABB_TREE; type <= UNIFORM_GRID; ++type)
+        {
+            PhysicsWorld world = {};
+            init_physics_world(&world, (BroadphaseType)type);
+            add_box_grid(&world, counts[c]);
+
+            double broadphase = 0;
+            double frame_time = 0;
+            double brute_force = 0;
+            int checks = 0;
+            s64 pairs = 0;
+            s64 pair_tests = 0;
+            bool found_all = true;
+            for(int frame = 0; frame < BROADPHASE_BENCH_FRAMES; ++frame)
+            {
+                double start = get_test_time_in_seconds();
+                update_pairs(&world);
+                broadphase += get_test_time_in_seconds() - start;
+                pairs += (s64)world.pairs.size();
+
+                if(brute_force_checked && frame % BROADPHASE_BENCH_CHECK_EVERY == 0)
+                {
+                    boxes.clear();
+                    for(RigidBody& body : world.bodies)
+                    {
+                        boxes.push_back(body.shape.aabb);
+                    }
+
+                    start = get_test_time_in_seconds();
+                    find_pairs_brute_force(boxes.data(), (int)boxes.size(), &expected);
+                    brute_force += get_test_time_in_seconds() - start;
+                    ++checks;
+
+                    bool found = type == AABB_TREE ? contains_pairs(&world.pairs, &expected) : world.pairs == expected;
+                    found_all = found_all && found;
+                }
+
+                //NOTE: The step runs the broadphase again, its time is the whole frame
+                start = get_test_time_in_seconds();
+                step_physics_world(&world, physics_dt);
+                frame_time += get_test_time_in_seconds() - start;
+                pair_tests += world.stats.pair_tests;
+            }
+
+            broadphase /= BROADPHASE_BENCH_FRAMES;
+            frame_time /= BROADPHASE_BENCH_FRAMES;
+            printf("%6d bodies %-16s broadphase %8.3f ms, frame %8.3f ms, pairs/frame %6d, pair tests/frame %6d", counts[c], names[type],
+                   broadphase * 1e3, frame_time * 1e3, (int)(pairs / BROADPHASE_BENCH_FRAMES), (int)(pair_tests / BROADPHASE_BENCH_FRAMES));
+            if(brute_force_checked)
+            {
+                brute_force /= checks;
+                printf(", brute force %9.3f ms (%.0fx)%s\n", brute_force * 1e3, brute_force / broadphase, found_all ? "" : " MISSED PAIRS");
+            }
+            else
+            {
+                printf(", brute force skipped\n");
+            }
+            ok = ok && found_all;
+            destroy_physics_world(&world);
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#include "physics_test.h"
+
+/*  NOTE: Broadphase thread scaling benchmark
+    Two copies of the same falling box grid, one finding its pairs on the calling thread
+    alone and one split over the worker threads, for 1, 2, 4 and 8 threads. Reports the
+    time of update_pairs for both and checks they find the same pairs every frame.
+    The speedup is only meaningful up to the number of cores the machine reports, the
+    counts above it are printed but oversubscribed.
+    Returns non zero when the threaded pairs differ.
+*/
+
+#define THREAD_BENCH_BODIES 10000
+#define THREAD_BENCH_FRAMES 30
+
+void add_box_grid(PhysicsWorld* world, int count)
+{
+    TestRandom random = {1};
+    int side = (int)sqrtf((float)count);
+
+    Shape ground = create_shape(V3(60.0f * side + 200, 100));
+    add_body(world, create_body(ground, V3(30.0f * side, -100), {}, 0));
+    destroy_shape(&ground);
+
+    Shape box = create_shape(V3(50, 50));
+    for(int i = 0; i < count; ++i)
+    {
+        Vector3 p = V3((i % side) * 52.0f + next_float(&random, 0, 4), (i / side) * 52.0f + next_float(&random, 0, 4));
+        add_body(world, create_body(box, p, {}, 1));
+    }
+    destroy_shape(&box);
+}
+
+int main()
+{
+    int cores = (int)std::thread::hardware_concurrency();
+    printf("%d cores\n", cores);
+
+    const char* names[] = {"aabb tree", "sweep and prune", "uniform grid"};
+    BroadphaseType types[] = {AABB_TREE, UNIFORM_GRID};
+    int thread_counts[] = {1, 2, 4, 8};
+
+    bool ok = true;
+    for(int t = 0; t < (int)ARRAY_SIZE(types); ++t)
+    {
+        for(int c = 0; c < (int)ARRAY_SIZE(thread_counts); ++c)
+        {
+            int threads = thread_counts[c];
+
+            PhysicsWorld single = {};
+            init_physics_world(&single, types[t]);
+            add_box_grid(&single, THREAD_BENCH_BODIES);
+
+            PhysicsWorld threaded = {};
+            init_physics_world(&threaded, types[t]);
+            set_worker_threads(&threaded, threads - 1);
+            add_box_grid(&threaded, THREAD_BENCH_BODIES);
+
+            double single_time = 0;
+            double threaded_time = 0;
+            bool same = true;
+            for(int frame = 0; frame < THREAD_BENCH_FRAMES; ++frame)
+            {
+                double start = get_test_time_in_seconds();
+                update_pairs(&single);
+                single_time += get_test_time_in_seconds() - start;
+
+                start = get_test_time_in_seconds();
+                update_pairs(&threaded);
+                threaded_time += get_test_time_in_seconds() - start;
+
+                same = same && single.pairs == threaded.pairs;
+
+                step_physics_world(&single, physics_dt);
+                step_physics_world(&threaded, physics_dt);
+            }
+
+            printf("%-16s %d thread%s %7.2f ms, 1 thread %7.2f ms, speedup %.2fx%s%s\n", names[types[t]], threads, threads == 1 ? " " : "s",
+                   threaded_time / THREAD_BENCH_FRAMES * 1e3, single_time / THREAD_BENCH_FRAMES * 1e3, single_time / threaded_time,
+                   threads > cores ? " (more threads than cores)" : "", same ? "" : " PAIRS DIFFER");
+            ok = ok && same;
+
+            destroy_physics_world(&single);
+            destroy_physics_world(&threaded);
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+#include "physics_test.h"
+
+/*  NOTE: Circle benchmark
+    A pile of CIRCLE_BENCH_BODIES circles and the same pile of boxes, same size, spacing
+    and jitter, dropped onto a ground on every broadphase type. Reports per frame the
+    whole step_physics_world, update_pairs alone, the pairs the narrowphase tested and
+    what each of them cost: the time of find_collisions minus an update_pairs on the same
+    unmoved bodies, divided by the pair tests. The piles fall for CIRCLE_BENCH_SETTLE_FRAMES
+    before anything is timed, so the pairs are the ones of a pile lying on the ground.
+*/
+
+#define CIRCLE_BENCH_BODIES 10000
+#define CIRCLE_BENCH_SETTLE_FRAMES 300
+#define CIRCLE_BENCH_FRAMES 100
+#define CIRCLE_BENCH_REPEATS 3
+
+struct CircleBenchRun
+{
+    double frame_time;
+    double broadphase_time;
+    double narrowphase_time;
+    s64 pair_tests;
+    int sleeping_bodies;
+};
+
+void add_pile(PhysicsWorld* world, ShapeType type, int count)
+{
+    TestRandom random = {1};
+    int side = (int)sqrtf((float)count);
+
+    Shape ground = create_shape(V3(60.0f * side + 200, 100));
+    add_body(world, create_body(ground, V3(30.0f * side, -100), {}, 0));
+    destroy_shape(&ground);
+
+    //NOTE: A circle's dim.x is its diameter, so both piles have the same extents
+    Shape shape = create_shape(V3(50, 50), type);
+    for(int i = 0; i < count; ++i)
+    {
+        Vector3 p = V3((i % side) * 52.0f + next_float(&random, 0, 4), (i / side) * 52.0f + next_float(&random, 0, 4));
+        add_body(world, create_body(shape, p, {}, 1));
+    }
+    destroy_shape(&shape);
+}
+
+CircleBenchRun run_circle_bench(BroadphaseType broadphase, ShapeType type)
+{
+    PhysicsWorld world = {};
+    init_physics_world(&world, broadphase);
+    add_pile(&world, type, CIRCLE_BENCH_BODIES);
+
+    for(int frame = 0; frame < CIRCLE_BENCH_SETTLE_FRAMES; ++frame)
+    {
+        step_physics_world(&world, physics_dt);
+    }
+
+    CircleBenchRun run = {};
+    for(int frame = 0; frame < CIRCLE_BENCH_FRAMES; ++frame)
+    {
+        double start = get_test_time_in_seconds();
+        update_pairs(&world);
+        run.broadphase_time += get_test_time_in_seconds() - start;
+
+        //NOTE: Nothing moves until the step, so the update_pairs inside find_collisions costs
+        //      what the one before it did and the rest is the narrowphase. The fastest of a
+        //      few runs of each, the broadphase time dwarfs the narrowphase on the tree
+        double unmoved_time = DBL_MAX;
+        double collide_time = DBL_MAX;
+        for(int repeat = 0; repeat < CIRCLE_BENCH_REPEATS; ++repeat)
+        {
+            start = get_test_time_in_seconds();
+            update_pairs(&world);
+            unmoved_time = min(unmoved_time, get_test_time_in_seconds() - start);
+
+            start = get_test_time_in_seconds();
+            find_collisions(&world);
+            collide_time = min(collide_time, get_test_time_in_seconds() - start);
+        }
+        run.narrowphase_time += max(collide_time - unmoved_time, 0.0);
+        run.pair_tests += world.stats.pair_tests;
+
+        start = get_test_time_in_seconds();
+        step_physics_world(&world, physics_dt);
+        run.frame_time += get_test_time_in_seconds() - start;
+    }
+    run.frame_time /= CIRCLE_BENCH_FRAMES;
+    run.broadphase_time /= CIRCLE_BENCH_FRAMES;
+    run.sleeping_bodies = world.stats.sleeping_bodies;
+
+    destroy_physics_world(&world);
+    return run;
+}
+
+int main()
+{
+    const char* broadphase_names[] = {"aabb tree", "sweep and prune", "uniform grid"};
+    ShapeType types[] = {ShapeType::CIRCLE, ShapeType::RECTANGLE};
+    const char* type_names[] = {"circles", "boxes"};
+
+    printf("%d bodies, %d frames after %d to settle\n", CIRCLE_BENCH_BODIES, CIRCLE_BENCH_FRAMES, CIRCLE_BENCH_SETTLE_FRAMES);
+    for(int broadphase = AABB_TREE; broadphase <= UNIFORM_GRID; ++broadphase)
+    {
+        for(int t = 0; t < (int)ARRAY_SIZE(types); ++t)
+        {
+            CircleBenchRun run = run_circle_bench((BroadphaseType)broadphase, types[t]);
+            double ns_per_test = run.pair_tests > 0 ? run.narrowphase_time / run.pair_tests * 1e9 : 0;
+            printf("%-16s %-7s frame %7.3f ms, broadphase %7.3f ms, pair tests/frame %6d, %6.1f ns/test, sleeping %5d\n",
+                   broadphase_names[broadphase], type_names[t], run.frame_time * 1e3, run.broadphase_time * 1e3,
+                   (int)(run.pair_tests / CIRCLE_BENCH_FRAMES), ns_per_test, run.sleeping_bodies);
+        }
+    }
+
+    return 0;
+}
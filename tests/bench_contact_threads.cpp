@@ -0,0 +1,105 @@
+#include "physics_test.h"
+
+/*  NOTE: Contact solver thread scaling benchmark
+    250 stacks of 20 boxes, about 10k contacts, stepped with the contact solve split over
+    1, 2, 4 and 8 threads. Reports the time of solve_contacts per step and checks every
+    run ends with the bodies where the single threaded run put them, the colors make the
+    order of the contacts the same whatever thread solves them.
+    The speedup is only meaningful up to the number of cores the machine reports, the
+    counts above it are printed but oversubscribed.
+    Returns non zero when a threaded run ends up somewhere else.
+*/
+
+#define CONTACT_BENCH_COLUMNS 250
+#define CONTACT_BENCH_ROWS 20
+#define CONTACT_BENCH_STEPS 600
+
+struct ContactBenchRun
+{
+    std::vector<Vector3> positions;
+    double solve_time;
+    int contacts;
+    int colors;
+};
+
+ContactBenchRun run_contact_bench(int threads)
+{
+    PhysicsWorld world = {};
+    init_physics_world(&world);
+    set_worker_threads(&world, threads - 1);
+
+    Shape ground = create_shape(V3(CONTACT_BENCH_COLUMNS * 64.0f, 50));
+    add_body(&world, create_body(ground, V3(CONTACT_BENCH_COLUMNS * 32.0f, 0), {}, 0));
+    destroy_shape(&ground);
+
+    Shape box = create_shape(V3(40, 40));
+    for(int column = 0; column < CONTACT_BENCH_COLUMNS; ++column)
+    {
+        for(int row = 0; row < CONTACT_BENCH_ROWS; ++row)
+        {
+            add_body(&world, create_body(box, V3(30 + column * 60.0f, 45 + row * 40.5f), {}, 1));
+        }
+    }
+    destroy_shape(&box);
+
+    ContactBenchRun run = {};
+    for(int step = 0; step < CONTACT_BENCH_STEPS; ++step)
+    {
+        find_collisions(&world);
+        integrate_for_velocity(&world, physics_dt);
+
+        double start = get_test_time_in_seconds();
+        solve_contacts(&world, physics_dt);
+        run.solve_time += get_test_time_in_seconds() - start;
+
+        integrate_for_position(&world, physics_dt);
+        solve_positions(&world);
+    }
+    run.solve_time /= CONTACT_BENCH_STEPS;
+
+    for(Manifold& m : world.manifolds)
+    {
+        run.contacts += m.contact_count;
+    }
+    run.colors = world.stats.contact_colors;
+    for(int i = 0; i < world.store.count; ++i)
+    {
+        run.positions.push_back(world.store.position[i]);
+    }
+
+    destroy_physics_world(&world);
+    return run;
+}
+
+int main()
+{
+    int cores = (int)std::thread::hardware_concurrency();
+    printf("%d cores\n", cores);
+
+    //NOTE: Sleeping would stop the stacks from reaching the solver once they settle
+    set_sleeping(false);
+
+    bool ok = true;
+    ContactBenchRun single = run_contact_bench(1);
+    printf("%d contacts in %d colors\n", single.contacts, single.colors);
+    printf("1 thread  %7.3f ms/step\n", single.solve_time * 1e3);
+
+    int thread_counts[] = {2, 4, 8};
+    for(int c = 0; c < (int)ARRAY_SIZE(thread_counts); ++c)
+    {
+        int threads = thread_counts[c];
+        ContactBenchRun threaded = run_contact_bench(threads);
+
+        float difference = 0;
+        for(int i = 0; i < (int)single.positions.size(); ++i)
+        {
+            difference = max(difference, length(single.positions[i] - threaded.positions[i]));
+        }
+
+        printf("%d threads %7.3f ms/step, speedup %.2fx, position difference %g%s\n", threads, threaded.solve_time * 1e3,
+               single.solve_time / threaded.solve_time, difference, threads > cores ? " (more threads than cores)" : "");
+        ok = ok && difference == 0;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+//NOTE: Replaces the global operator new, so this file is its own program
+#define PHYSICS_COUNT_ALLOCATIONS
+#include "physics_test.h"
+
+/*  NOTE: Narrowphase allocation check
+    Stacks of boxes and triangles settle for ALLOCATION_CHECK_SETTLE_STEPS, long enough for
+    the pair count to reach its maximum and every manifold array to grow to it. The next
+    ALLOCATION_CHECK_STEPS steps have to find their contacts without a single heap
+    allocation, checked through stats.narrowphase_allocations on every integrator path
+    and broadphase. Returns non zero when a step allocated.
+*/
+
+#define ALLOCATION_CHECK_COLUMNS 40
+#define ALLOCATION_CHECK_ROWS 10
+#define ALLOCATION_CHECK_SETTLE_STEPS 600
+#define ALLOCATION_CHECK_STEPS 600
+
+//NOTE: Largest narrowphase_allocations of any checked step, first_step is the count of
+//      the first step, when the manifold arrays are still empty and have to grow
+int run_allocation_check(IntegratorPath path, BroadphaseType broadphase, int* pair_tests, int* first_step)
+{
+    PhysicsWorld world = {};
+    init_physics_world(&world, broadphase);
+    set_integrator_path(&world, path);
+
+    Shape ground = create_shape(V3(ALLOCATION_CHECK_COLUMNS * 120.0f, 50));
+    add_body(&world, create_body(ground, V3(ALLOCATION_CHECK_COLUMNS * 60.0f, 0), {}, 0));
+    destroy_shape(&ground);
+
+    Shape box = create_shape(V3(40, 40));
+    Shape triangle = create_shape(V3(40, 40), ShapeType::TRIANGLE);
+    for(int column = 0; column < ALLOCATION_CHECK_COLUMNS; ++column)
+    {
+        for(int row = 0; row < ALLOCATION_CHECK_ROWS; ++row)
+        {
+            add_body(&world, create_body(box, V3(30 + column * 60.0f, 45 + row * 40.5f), {}, 1));
+        }
+        //NOTE: A triangle on top of every other stack so the general SAT kernel runs too
+        if(column % 2 == 0)
+        {
+            add_body(&world, create_body(triangle, V3(30 + column * 60.0f, 45 + ALLOCATION_CHECK_ROWS * 40.5f), {}, 1));
+        }
+    }
+    destroy_shape(&box);
+    destroy_shape(&triangle);
+
+    for(int step = 0; step < ALLOCATION_CHECK_SETTLE_STEPS; ++step)
+    {
+        step_physics_world(&world, physics_dt);
+        if(step == 0) *first_step = world.stats.narrowphase_allocations;
+    }
+
+    int allocations = 0;
+    *pair_tests = 0;
+    for(int step = 0; step < ALLOCATION_CHECK_STEPS; ++step)
+    {
+        step_physics_world(&world, physics_dt);
+        allocations = max(allocations, world.stats.narrowphase_allocations);
+        *pair_tests = max(*pair_tests, world.stats.pair_tests);
+    }
+
+    destroy_physics_world(&world);
+    return allocations;
+}
+
+int main()
+{
+    //NOTE: Sleeping islands skip the narrowphase, the stacks have to stay awake to be tested
+    set_sleeping(false);
+
+    const char* names[] = {"aabb tree", "sweep and prune", "uniform grid"};
+    bool ok = true;
+    IntegratorPath supported = get_supported_integrator_path();
+    for(int path = INTEGRATOR_SCALAR; path <= supported; ++path)
+    {
+        for(int broadphase = AABB_TREE; broadphase <= UNIFORM_GRID; ++broadphase)
+        {
+            int pair_tests = 0;
+            int first_step = 0;
+            int allocations = run_allocation_check((IntegratorPath)path, (BroadphaseType)broadphase, &pair_tests, &first_step);
+            printf("path %d %-16s pair tests/step %d, narrowphase allocations first step %d, settled %d\n", path, names[broadphase],
+                   pair_tests, first_step, allocations);
+
+            //NOTE: A counter that didn't see the first step grow anything isn't counting
+            ok = ok && allocations == 0 && pair_tests > 0 && first_step > 0;
+        }
+    }
+
+    printf(ok ? "no allocations\n" : "the narrowphase allocated\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+#include "physics_test.h"
+
+/*  NOTE: Circle resting contact check
+    A circle dropped onto a static circle straight below it, and a circle dropped onto a
+    box ground, added before and after the ground so both test_polygon_circle and
+    test_circle_polygon run. After CIRCLE_CHECK_STEPS every dropped circle has to rest
+    where the radii put it, within CIRCLE_CHECK_TOLERANCE, slower than
+    CIRCLE_CHECK_REST_SPEED and without drifting sideways.
+    Returns non zero when one doesn't come to rest.
+*/
+
+#define CIRCLE_CHECK_STEPS 600
+#define CIRCLE_CHECK_TOLERANCE 1.0f
+#define CIRCLE_CHECK_REST_SPEED 1.0f
+
+enum CircleCheckScene
+{
+    CIRCLE_ON_CIRCLE,
+    CIRCLE_ON_GROUND,
+    GROUND_UNDER_CIRCLE,
+
+    CIRCLE_CHECK_SCENE_COUNT
+};
+
+//NOTE: Adds the static support of scene, returns the height the dropped circle rests at
+float add_support(PhysicsWorld* world, CircleCheckScene scene)
+{
+    if(scene == CIRCLE_ON_CIRCLE)
+    {
+        Shape support = create_shape(V3(60, 60), ShapeType::CIRCLE);
+        add_body(world, create_body(support, V3(100, 0), {}, 0));
+        destroy_shape(&support);
+        return 30 + 20;
+    }
+
+    Shape ground = create_shape(V3(400, 50));
+    add_body(world, create_body(ground, V3(100, 0), {}, 0));
+    destroy_shape(&ground);
+    return 25 + 20;
+}
+
+bool check_circle_scene(CircleCheckScene scene)
+{
+    PhysicsWorld world = {};
+    init_physics_world(&world);
+
+    Shape circle = create_shape(V3(40, 40), ShapeType::CIRCLE);
+    RigidBody dropped = create_body(circle, V3(100, 120), {}, 1);
+    destroy_shape(&circle);
+
+    //NOTE: Pairs keep the lower body index as a, the order decides which test runs
+    float rest_height = 0;
+    int index = 0;
+    if(scene == GROUND_UNDER_CIRCLE)
+    {
+        index = add_body(&world, dropped);
+        rest_height = add_support(&world, scene);
+    }
+    else
+    {
+        rest_height = add_support(&world, scene);
+        index = add_body(&world, dropped);
+    }
+
+    for(int step = 0; step < CIRCLE_CHECK_STEPS; ++step)
+    {
+        step_physics_world(&world, physics_dt);
+    }
+
+    Vector3 p = world.store.position[index];
+    float speed = length(world.store.velocity[index]);
+    bool resting = fabsf(p.y - rest_height) < CIRCLE_CHECK_TOLERANCE && fabsf(p.x - 100) < CIRCLE_CHECK_TOLERANCE &&
+                   speed < CIRCLE_CHECK_REST_SPEED && world.manifolds.size() == 1;
+
+    const char* names[] = {"circle on circle", "circle on ground", "ground under circle"};
+    printf("%-20s at %.2f, %.2f (rest height %.2f) speed %.3f manifolds %d%s\n", names[scene], p.x, p.y, rest_height, speed,
+           (int)world.manifolds.size(), resting ? "" : " NOT AT REST");
+
+    destroy_physics_world(&world);
+    return resting;
+}
+
+int main()
+{
+    bool ok = true;
+    for(int scene = 0; scene < CIRCLE_CHECK_SCENE_COUNT; ++scene)
+    {
+        ok = check_circle_scene((CircleCheckScene)scene) && ok;
+    }
+
+    printf(ok ? "circles at rest\n" : "a circle didn't come to rest\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+#include "physics_test.h"
+
+/*  NOTE: Contact refresh check
+    Stacks of boxes on a ground, stepped once with the narrowphase testing every pair
+    every step and once with set_contact_refresh moving the resting manifolds along from
+    their anchors. Sleeping is off so the stacks stay in the narrowphase the whole run.
+    Both runs have to leave the stacks standing at rest, and every box has to end up
+    within REFRESH_CHECK_TOLERANCE of where the other run put it.
+    Returns non zero when they don't agree.
+*/
+
+#define REFRESH_CHECK_COLUMNS 10
+#define REFRESH_CHECK_ROWS 20
+#define REFRESH_CHECK_STEPS 2400
+#define REFRESH_CHECK_BOX 40.0f
+#define REFRESH_CHECK_TOLERANCE 0.5f
+#define REFRESH_CHECK_REST_SPEED 1.0f
+
+struct RefreshRun
+{
+    std::vector<Vector3> positions;
+    float top;
+    float max_speed;
+    int pair_tests;
+    int refreshes;
+};
+
+RefreshRun run_stacks(bool refresh, int substeps)
+{
+    set_contact_refresh(refresh);
+
+    PhysicsWorld world = {};
+    init_physics_world(&world);
+    set_solver_substeps(&world, substeps);
+
+    Shape ground = create_shape(V3(REFRESH_CHECK_COLUMNS * REFRESH_CHECK_BOX * 2, 50));
+    add_body(&world, create_body(ground, V3(REFRESH_CHECK_COLUMNS * REFRESH_CHECK_BOX, 0), {}, 0));
+    destroy_shape(&ground);
+
+    Shape box = create_shape(V3(REFRESH_CHECK_BOX, REFRESH_CHECK_BOX));
+    for(int column = 0; column < REFRESH_CHECK_COLUMNS; ++column)
+    {
+        for(int row = 0; row < REFRESH_CHECK_ROWS; ++row)
+        {
+            //NOTE: A small gap between the rows so every stack has to settle
+            Vector3 p = V3(30 + column * 1.5f * REFRESH_CHECK_BOX, 45 + row * (REFRESH_CHECK_BOX + 0.5f));
+            RigidBody body = create_body(box, p, {}, 1);
+            body.friction = 0.5f;
+            add_body(&world, body);
+        }
+    }
+    destroy_shape(&box);
+
+    RefreshRun run = {};
+    for(int step = 0; step < REFRESH_CHECK_STEPS; ++step)
+    {
+        step_physics_world(&world, physics_dt);
+        run.pair_tests += world.stats.pair_tests;
+        run.refreshes += world.stats.contact_refreshes;
+    }
+
+    run.top = -FLT_MAX;
+    for(int i = 0; i < world.store.count; ++i)
+    {
+        run.positions.push_back(world.store.position[i]);
+        if(world.store.inverse_mass[i] == 0) continue;
+
+        run.top = max(run.top, world.store.position[i].y);
+        run.max_speed = max(run.max_speed, length(world.store.velocity[i]));
+    }
+
+    destroy_physics_world(&world);
+    return run;
+}
+
+int main()
+{
+    set_sleeping(false);
+
+    bool ok = true;
+    float ideal_top = 45 + (REFRESH_CHECK_ROWS - 1) * REFRESH_CHECK_BOX;
+    int substep_counts[] = {0, 4};
+    for(int i = 0; i < (int)ARRAY_SIZE(substep_counts); ++i)
+    {
+        int substeps = substep_counts[i];
+        RefreshRun tested = run_stacks(false, substeps);
+        RefreshRun refreshed = run_stacks(true, substeps);
+
+        float difference = 0;
+        for(int body = 0; body < (int)tested.positions.size(); ++body)
+        {
+            difference = max(difference, length(tested.positions[body] - refreshed.positions[body]));
+        }
+
+        RefreshRun* runs[2] = {&tested, &refreshed};
+        const char* names[2] = {"every step", "refresh"};
+        for(int k = 0; k < 2; ++k)
+        {
+            bool standing = fabsf(runs[k]->top - ideal_top) < REFRESH_CHECK_BOX * 0.5f && runs[k]->max_speed < REFRESH_CHECK_REST_SPEED;
+            ok = ok && standing;
+            printf("substeps %d %-10s top %.2f (ideal %.2f) max speed %.3f tests/step %d refreshes/step %d%s\n", substeps, names[k],
+                   runs[k]->top, ideal_top, runs[k]->max_speed, runs[k]->pair_tests / REFRESH_CHECK_STEPS,
+                   runs[k]->refreshes / REFRESH_CHECK_STEPS, standing ? "" : " NOT AT REST");
+        }
+
+        //NOTE: A refresh run that never refreshed compares the narrowphase with itself
+        ok = ok && refreshed.refreshes > 0 && difference <= REFRESH_CHECK_TOLERANCE;
+        printf("substeps %d position difference %g\n", substeps, difference);
+    }
+
+    set_contact_refresh(false);
+    printf(ok ? "refresh matches the narrowphase\n" : "refresh doesn't match the narrowphase\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+#include "physics_test.h"
+
+/*  NOTE: GJK check
+    Random custom polygon pairs drifting a little every frame go through test_gjk twice,
+    once from scratch and once with the GjkCache the pair left last frame. Every hit has to
+    have the depth and normal of the brute force Minkowski difference, both ways.
+    Then stacks of custom hexagons settle on a box ground, where every pair runs test_gjk
+    through find_collisions. Once they rest every tested pair has to keep a simplex in
+    world.gjk_caches and every touching one the triangle it hands straight to EPA.
+    Returns non zero when a depth, a normal or a cache is off.
+*/
+
+#define GJK_CHECK_PAIRS 1024
+#define GJK_CHECK_FRAMES 50
+#define GJK_CHECK_TOLERANCE 1e-2f
+#define GJK_CHECK_COLUMNS 4
+#define GJK_CHECK_ROWS 8
+#define GJK_CHECK_SETTLE_STEPS 600
+#define GJK_CHECK_STEPS 120
+
+//NOTE: Least depth over every edge normal of both shapes in both directions, normal from a to b
+float find_minkowski_depth(Shape* a, Shape* b, Vector3* normal)
+{
+    float depth = FLT_MAX;
+    for(int s = 0; s < 4; ++s)
+    {
+        Shape* owner = s & 1 ? b : a;
+        for(int k = 0; k < owner->vertices_count; ++k)
+        {
+            Vector3 n = s & 2 ? -owner->global_normals[k] : owner->global_normals[k];
+            float h = -FLT_MAX;
+            for(int i = 0; i < a->vertices_count; ++i)
+            {
+                for(int j = 0; j < b->vertices_count; ++j)
+                {
+                    h = max(h, dot(a->global_vertices[i] - b->global_vertices[j], n));
+                }
+            }
+            if(h < depth)
+            {
+                depth = h;
+                *normal = n;
+            }
+        }
+    }
+    return depth;
+}
+
+bool check_gjk_pairs()
+{
+    static Vector3 vertices[GJK_CHECK_PAIRS * 2][SHAPE_MAX_VERTICES];
+    static Vector3 normals[GJK_CHECK_PAIRS * 2][SHAPE_MAX_VERTICES];
+    static RigidBody bodies[GJK_CHECK_PAIRS * 2];
+    static Vector3 velocities[GJK_CHECK_PAIRS * 2];
+    static float angles[GJK_CHECK_PAIRS * 2];
+    static GjkCache caches[GJK_CHECK_PAIRS];
+
+    //NOTE: Regular polygons of 3 to SHAPE_MAX_VERTICES vertices, stretched per body
+    Shape polygons[SHAPE_MAX_VERTICES + 1];
+    for(int n = 3; n <= SHAPE_MAX_VERTICES; ++n)
+    {
+        Vector3 v[SHAPE_MAX_VERTICES];
+        for(int i = 0; i < n; ++i)
+        {
+            v[i] = V3(0.5f * cosf(2 * PI * i / n), 0.5f * sinf(2 * PI * i / n));
+        }
+        polygons[n] = create_shape(V3(1, 1), ShapeType::CUSTOM, v, n);
+    }
+
+    TestRandom random = {4242};
+    for(int i = 0; i < GJK_CHECK_PAIRS * 2; ++i)
+    {
+        int n = min(3 + (int)next_float(&random, 0, SHAPE_MAX_VERTICES - 2), SHAPE_MAX_VERTICES);
+        bodies[i] = {};
+        bodies[i].shape = polygons[n];
+        bodies[i].shape.dim = V3(next_float(&random, 20, 80), next_float(&random, 20, 80));
+        bodies[i].shape.global_vertices = vertices[i];
+        bodies[i].shape.global_normals = normals[i];
+        bodies[i].position = i & 1 ? bodies[i - 1].position + V3(next_float(&random, -60, 60), next_float(&random, -60, 60))
+                                   : V3(next_float(&random, 0, 1000), next_float(&random, 0, 1000));
+        velocities[i] = V3(next_float(&random, -0.3f, 0.3f), next_float(&random, -0.3f, 0.3f));
+        angles[i] = next_float(&random, -3, 3);
+    }
+
+    int hits = 0;
+    int errors[2] = {};
+    for(int frame = 0; frame < GJK_CHECK_FRAMES; ++frame)
+    {
+        for(int i = 0; i < GJK_CHECK_PAIRS * 2; ++i)
+        {
+            bodies[i].position = bodies[i].position + velocities[i];
+            angles[i] += 0.01f * (i % 3 - 1);
+            update_shape(&bodies[i].shape, bodies[i].position, make_rotation(angles[i]));
+        }
+
+        for(int i = 0; i < GJK_CHECK_PAIRS; ++i)
+        {
+            RigidBody* a = &bodies[i * 2];
+            RigidBody* b = &bodies[i * 2 + 1];
+            Manifold fresh = {};
+            Manifold cached = {};
+            cached.gjk_cache = caches[i];
+            bool hit = test_gjk(a, b, &fresh);
+            bool cached_hit = test_gjk(a, b, &cached);
+            caches[i] = cached.gjk_cache;
+
+            Vector3 normal = {};
+            float depth = find_minkowski_depth(&a->shape, &b->shape, &normal);
+            bool touching = depth >= 0;
+            Manifold* results[2] = {&fresh, &cached};
+            bool result_hits[2] = {hit, cached_hit};
+            for(int k = 0; k < 2; ++k)
+            {
+                //NOTE: Grazing pairs may go either way
+                if(result_hits[k] != touching)
+                {
+                    if(fabsf(depth) > GJK_CHECK_TOLERANCE) ++errors[k];
+                    continue;
+                }
+                if(!touching) continue;
+
+                if(fabsf(results[k]->depth - depth) > GJK_CHECK_TOLERANCE || dot(results[k]->normal, normal) < 0.999f)
+                {
+                    ++errors[k];
+                }
+            }
+            hits += touching;
+        }
+    }
+
+    for(int n = 3; n <= SHAPE_MAX_VERTICES; ++n)
+    {
+        destroy_shape(&polygons[n]);
+    }
+
+    printf("%d queries, %d touching, errors from scratch %d, cached %d\n", GJK_CHECK_PAIRS * GJK_CHECK_FRAMES, hits, errors[0], errors[1]);
+    return hits > 0 && errors[0] == 0 && errors[1] == 0;
+}
+
+bool check_gjk_stacks()
+{
+    PhysicsWorld world = {};
+    init_physics_world(&world);
+
+    Shape ground = create_shape(V3(GJK_CHECK_COLUMNS * 120.0f, 50));
+    add_body(&world, create_body(ground, V3(GJK_CHECK_COLUMNS * 30.0f, 0), {}, 0));
+    destroy_shape(&ground);
+
+    //NOTE: Flat top and bottom so the hexagons stack like boxes
+    Vector3 v[] = {V3(0.5f, 0), V3(0.25f, 0.5f), V3(-0.25f, 0.5f), V3(-0.5f, 0), V3(-0.25f, -0.5f), V3(0.25f, -0.5f)};
+    Shape hexagon = create_shape(V3(40, 40), ShapeType::CUSTOM, v, ARRAY_SIZE(v));
+    for(int column = 0; column < GJK_CHECK_COLUMNS; ++column)
+    {
+        for(int row = 0; row < GJK_CHECK_ROWS; ++row)
+        {
+            add_body(&world, create_body(hexagon, V3(column * 60.0f, 45 + row * 40.5f), {}, 1));
+        }
+    }
+    destroy_shape(&hexagon);
+
+    for(int step = 0; step < GJK_CHECK_SETTLE_STEPS; ++step)
+    {
+        step_physics_world(&world, physics_dt);
+    }
+
+    bool kept = true;
+    for(int step = 0; step < GJK_CHECK_STEPS; ++step)
+    {
+        step_physics_world(&world, physics_dt);
+
+        int triangles = 0;
+        for(GjkCacheRef& ref : world.gjk_caches)
+        {
+            triangles += ref.cache.count == 3;
+        }
+        kept = kept && (int)world.gjk_caches.size() == world.stats.pair_tests && triangles >= world.stats.manifolds;
+    }
+
+    float top = -FLT_MAX;
+    float max_speed = 0;
+    for(int i = 0; i < world.store.count; ++i)
+    {
+        if(world.store.inverse_mass[i] == 0) continue;
+        top = max(top, world.store.position[i].y);
+        max_speed = max(max_speed, length(world.store.velocity[i]));
+    }
+    float ideal_top = 45 + (GJK_CHECK_ROWS - 1) * 40.0f;
+    bool resting = fabsf(top - ideal_top) < 5 && max_speed < 1;
+
+    printf("pair tests %d, manifolds %d, cached simplices %d, top %.2f (ideal %.2f), max speed %.3f%s%s\n", world.stats.pair_tests,
+           world.stats.manifolds, (int)world.gjk_caches.size(), top, ideal_top, max_speed, kept ? "" : " CACHE LOST",
+           resting ? "" : " NOT AT REST");
+
+    destroy_physics_world(&world);
+    return kept && resting;
+}
+
+int main()
+{
+    //NOTE: Sleeping pairs keep their simplex without a test, the stacks have to stay awake
+    set_sleeping(false);
+
+    bool ok = check_gjk_pairs();
+    ok = check_gjk_stacks() && ok;
+
+    printf(ok ? "gjk matches\n" : "gjk doesn't match\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include "physics_test.h"
+
+/*  NOTE: SAT axis cache check
+    Stacks of boxes resting on a ground, each with a static box turned into a diamond off
+    the top corner of its top box. The diamond's AABB and bounding circle reach into the
+    top box, so the pair gets to the narrowphase and is separated there. Once the stacks
+    settle, every tested pair has to leave its deciding axis in world.sat_axes and the
+    axes can't change from one step to the next. Each separated pair then costs a single
+    axis, the cached one, and each touching pair the 4 axes of a box. Runs on the default
+    integrator path, where the boxes go through collide_box_box_batch, and on the scalar
+    one, which have to end up with the same axes.
+    Returns non zero when a pair loses or changes its axis.
+*/
+
+#define SAT_AXES_CHECK_COLUMNS 4
+#define SAT_AXES_CHECK_ROWS 10
+#define SAT_AXES_CHECK_SETTLE_STEPS 600
+#define SAT_AXES_CHECK_STEPS 120
+
+bool same_sat_axes(std::vector<SatAxisRef>* a, std::vector<SatAxisRef>* b)
+{
+    if(a->size() != b->size()) return false;
+    for(int i = 0; i < (int)a->size(); ++i)
+    {
+        if((*a)[i].key != (*b)[i].key || (*a)[i].axis != (*b)[i].axis) return false;
+    }
+    return true;
+}
+
+//NOTE: Fills axes with the ones the stacks end up with
+bool check_sat_axes(IntegratorPath path, std::vector<SatAxisRef>* axes)
+{
+    PhysicsWorld world = {};
+    init_physics_world(&world);
+    set_integrator_path(&world, path);
+
+    Shape ground = create_shape(V3(SAT_AXES_CHECK_COLUMNS * 100.0f, 50));
+    add_body(&world, create_body(ground, V3(SAT_AXES_CHECK_COLUMNS * 35.0f, 0), {}, 0));
+    destroy_shape(&ground);
+
+    //NOTE: The boxes start stacked without gaps, the top one at top. The diamonds have a
+    //      half diagonal of 20 and sit 32, 32 off it: 2.8 clear of its corner, well inside
+    //      the bounding circles that have to overlap for the pair to be tested
+    float top = 45 + (SAT_AXES_CHECK_ROWS - 1) * 40.0f;
+    Shape box = create_shape(V3(40, 40));
+    Shape diamond = create_shape(V3(20 * sqrtf(2.0f), 20 * sqrtf(2.0f)));
+    for(int column = 0; column < SAT_AXES_CHECK_COLUMNS; ++column)
+    {
+        for(int row = 0; row < SAT_AXES_CHECK_ROWS; ++row)
+        {
+            add_body(&world, create_body(box, V3(column * 70.0f, 45 + row * 40.0f), {}, 1));
+        }
+
+        RigidBody body = create_body(diamond, V3(column * 70.0f + 32, top + 32), {}, 0);
+        body.orientation = make_rotation(0.25f * PI);
+        add_body(&world, body);
+    }
+    destroy_shape(&box);
+    destroy_shape(&diamond);
+
+    for(int step = 0; step < SAT_AXES_CHECK_SETTLE_STEPS; ++step)
+    {
+        step_physics_world(&world, physics_dt);
+    }
+
+    bool kept = true;
+    bool cached = true;
+    std::vector<SatAxisRef> last = world.sat_axes;
+    for(int step = 0; step < SAT_AXES_CHECK_STEPS; ++step)
+    {
+        step_physics_world(&world, physics_dt);
+
+        PhysicsStats* stats = &world.stats;
+        int separated = stats->pair_tests - stats->manifolds;
+        kept = kept && (int)world.sat_axes.size() == stats->pair_tests && same_sat_axes(&world.sat_axes, &last);
+        cached = cached && separated > 0 && stats->sat_axes_tested == separated + 4 * stats->manifolds;
+        last = world.sat_axes;
+    }
+
+    PhysicsStats* stats = &world.stats;
+    printf("path %d pair tests %d, separated %d, axes %d, axes tested %d%s%s\n", path, stats->pair_tests,
+           stats->pair_tests - stats->manifolds, (int)world.sat_axes.size(), stats->sat_axes_tested,
+           kept ? "" : " AXES LOST OR CHANGED", cached ? "" : " CACHE NOT USED");
+
+    *axes = world.sat_axes;
+    destroy_physics_world(&world);
+    return kept && cached;
+}
+
+int main()
+{
+    //NOTE: Sleeping pairs keep their axis without a test, the stacks have to stay awake
+    set_sleeping(false);
+
+    std::vector<SatAxisRef> axes;
+    std::vector<SatAxisRef> scalar_axes;
+    IntegratorPath path = get_supported_integrator_path();
+    bool ok = check_sat_axes(path, &axes);
+    ok = check_sat_axes(INTEGRATOR_SCALAR, &scalar_axes) && ok;
+
+    bool same = same_sat_axes(&axes, &scalar_axes);
+    printf(same ? "paths agree on the axes\n" : "paths disagree on the axes\n");
+
+    ok = ok && same;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+#include "physics_test.h"
+
+/*  NOTE: SIMD path checks
+    Every SIMD kernel does its math in the same order as the scalar one, this runs random
+    input through each path the cpu supports and the scalar reference and compares:
+        integrator    positions, velocities and orientations after INTEGRATOR_CHECK_STEPS
+        box vs box    hit, depth, normal and contact count of random box pairs (2D)
+        contact rows  velocities and accumulated impulses after a few iterations (2D)
+    Returns non zero when a path is off.
+*/
+
+#define INTEGRATOR_CHECK_BODIES 64
+#define INTEGRATOR_CHECK_STEPS 10000
+#define INTEGRATOR_CHECK_TOLERANCE 1e-4f
+//NOTE: Full batches, then an odd one at the end so the scalar tail runs too
+#define BOX_BOX_CHECK_PAIRS 20003
+#define CONTACT_CHECK_BLOCKS 200
+#define CONTACT_CHECK_TOLERANCE 1e-4f
+
+inline float integrator_difference(float a, float b)
+{
+    return fabsf(a - b) / max(1.0f, fabsf(b));
+}
+
+inline float integrator_difference(Vector3 a, Vector3 b)
+{
+    return max(max(integrator_difference(a.x, b.x), integrator_difference(a.y, b.y)), integrator_difference(a.z, b.z));
+}
+
+#ifdef PHYSICS_3D
+inline float integrator_difference(Quaternion a, Quaternion b)
+{
+    return max(integrator_difference(a.xyz, b.xyz), integrator_difference(a.w, b.w));
+}
+#else
+inline float integrator_difference(Rotation a, Rotation b)
+{
+    return max(integrator_difference(a.c, b.c), integrator_difference(a.s, b.s));
+}
+#endif
+
+//NOTE: Runs the same bodies through path and the scalar reference, returns the largest
+//      relative difference in position, velocity, angular velocity or orientation
+float compare_integrator_paths(IntegratorPath path, int body_count, int steps, float dt)
+{
+    BodyStore wide = {};
+    init_body_store(&wide);
+
+    TestRandom random = {12345};
+
+    for(int i = 0; i < body_count; ++i)
+    {
+#ifdef PHYSICS_3D
+        Mat3 inertia = {};
+        inertia._11 = next_float(&random, 0.001f, 0.01f);
+        inertia._22 = next_float(&random, 0.001f, 0.01f);
+        inertia._33 = next_float(&random, 0.001f, 0.01f);
+        inertia._12 = inertia._21 = next_float(&random, -0.001f, 0.001f);
+
+        Rotation q = normalize(make_quaternion(V3(next_float(&random, -1, 1), next_float(&random, -1, 1), next_float(&random, -1, 1)), next_float(&random, -1, 1)));
+        Angular w = V3(next_float(&random, -2, 2), next_float(&random, -2, 2), next_float(&random, -2, 2));
+        Angular torque = V3(next_float(&random, -10, 10), next_float(&random, -10, 10), next_float(&random, -10, 10));
+#else
+        InverseInertia inertia = next_float(&random, 0.001f, 0.01f);
+        Rotation q = make_rotation(next_float(&random, -3, 3));
+        Angular w = next_float(&random, -2, 2);
+        Angular torque = next_float(&random, -10, 10);
+#endif
+
+        //NOTE: Mix in static, sleeping and frozen bodies so every mask gets exercised
+        float inverse_mass = (i % 7 == 3) ? 0 : next_float(&random, 0.1f, 2.0f);
+        u32 flags = 0;
+        if(i % 5 == 2) flags |= BODY_SLEEPING;
+        if(i % 6 == 1) flags |= BODY_FREEZE_ORIENTATION;
+
+        int index = body_store_add(&wide, V3(next_float(&random, -500, 500), next_float(&random, -500, 500), next_float(&random, -1, 1)),
+                                   V3(next_float(&random, -50, 50), next_float(&random, -50, 50), next_float(&random, -1, 1)), q,
+                                   w, inverse_mass, inertia, flags);
+        wide.force[index] = V3(next_float(&random, -100, 100), next_float(&random, -100, 100), 0);
+        wide.torque[index] = torque;
+    }
+    BodyStore reference = wide;
+
+    for(int step = 0; step < steps; ++step)
+    {
+        integrate_velocity(&wide, path, dt, physics_damping_factor);
+        integrate_position(&wide, path, dt);
+        integrate_velocity(&reference, INTEGRATOR_SCALAR, dt, physics_damping_factor);
+        integrate_position(&reference, INTEGRATOR_SCALAR, dt);
+    }
+
+    float difference = 0;
+    for(int i = 0; i < body_count; ++i)
+    {
+        difference = max(difference, integrator_difference(wide.position[i], reference.position[i]));
+        difference = max(difference, integrator_difference(wide.velocity[i], reference.velocity[i]));
+        difference = max(difference, integrator_difference(wide.angular_velocity[i], reference.angular_velocity[i]));
+        difference = max(difference, integrator_difference(wide.orientation[i], reference.orientation[i]));
+    }
+
+    return difference;
+}
+
+#ifndef PHYSICS_3D
+
+//NOTE: Random box pairs through path and test_box_box, each with a random cached axis or
+//      none, returns how many came out different
+int compare_box_box_paths(IntegratorPath path, int pair_count)
+{
+    static Vector3 vertices[BOX_BOX_LANES * 2][4];
+    static Vector3 normals[BOX_BOX_LANES * 2][4];
+    static RigidBody bodies[BOX_BOX_LANES * 2];
+    static int cached[BOX_BOX_LANES];
+    static BoxBoxLanes lanes;
+
+    TestRandom random = {54321};
+
+    int mismatches = 0;
+    for(int done = 0; done < pair_count; done += BOX_BOX_LANES)
+    {
+        int count = min(BOX_BOX_LANES, pair_count - done);
+        lanes.count = 0;
+        for(int i = 0; i < count * 2; ++i)
+        {
+            bodies[i] = {};
+            bodies[i].shape = create_shape(V3(next_float(&random, 10, 100), next_float(&random, 10, 100)));
+            bodies[i].shape.global_vertices = vertices[i];
+            bodies[i].shape.global_normals = normals[i];
+            update_shape(&bodies[i].shape, V3(next_float(&random, 0, 150), next_float(&random, 0, 150)), make_rotation(next_float(&random, -3, 3)));
+        }
+        for(int i = 0; i < count; ++i)
+        {
+            int axis = (int)floorf(next_float(&random, -1, 4));
+            cached[i] = axis < 0 ? SAT_AXIS_NONE : get_box_box_sat_axis(axis);
+            add_box_box_lane(&lanes, &bodies[i * 2].shape, &bodies[i * 2 + 1].shape, cached[i]);
+        }
+        sat_box_box_lanes(&lanes, path);
+
+        for(int i = 0; i < count; ++i)
+        {
+            Manifold wide = {};
+            Manifold reference = {};
+            reference.sat_axis = cached[i];
+            bool hit = set_box_box_lane_manifold(&lanes, i, &bodies[i * 2], &bodies[i * 2 + 1], &wide);
+            bool reference_hit = test_box_box(&bodies[i * 2], &bodies[i * 2 + 1], &reference);
+            if(hit != reference_hit || wide.sat_axis != reference.sat_axis || wide.sat_axes_tested != reference.sat_axes_tested ||
+               (hit && (wide.depth != reference.depth || !(wide.normal == reference.normal) ||
+                        wide.contact_count != reference.contact_count)))
+            {
+                ++mismatches;
+            }
+        }
+
+        for(int i = 0; i < count * 2; ++i)
+        {
+            destroy_shape(&bodies[i].shape);
+        }
+    }
+
+    return mismatches;
+}
+
+//NOTE: Random blocks of disjoint bodies through path and the scalar kernel, returns the
+//      largest difference in the velocities and accumulated impulses they end up with
+float compare_contact_row_paths(IntegratorPath path, int block_count, int iterations)
+{
+    static ContactRowBlock blocks[2];
+    static BodyStore stores[2];
+
+    TestRandom random = {98765};
+
+    float difference = 0;
+    for(int done = 0; done < block_count; ++done)
+    {
+        //NOTE: Body 0 is static and shared by some lanes, the rest get a body each
+        init_body_store(&stores[0]);
+        body_store_add(&stores[0], V3(), V3(), make_rotation(0), 0, 0, 0, 0);
+        for(int i = 0; i < CONTACT_ROW_LANES * 2; ++i)
+        {
+            body_store_add(&stores[0], V3(), V3(next_float(&random, -50, 50), next_float(&random, -50, 50)), make_rotation(0), next_float(&random, -2, 2),
+                           next_float(&random, 0.1f, 1), next_float(&random, 0.0001f, 0.01f), 0);
+        }
+
+        for(int i = 0; i < CONTACT_ROW_LANES; ++i)
+        {
+            //NOTE: Last lane is padding, every third lane has a single contact
+            if(i == CONTACT_ROW_LANES - 1)
+            {
+                clear_contact_lane(&blocks[0], i);
+                continue;
+            }
+
+            Manifold m = {};
+            m.index_a = next_float(&random, 0, 1) < 0.3f ? 0 : 1 + i * 2;
+            m.index_b = 2 + i * 2;
+            m.friction = next_float(&random, 0, 1);
+            m.normal = normalize(V3(next_float(&random, -1, 1), next_float(&random, -1, 1)));
+            m.contact_count = i % 3 == 0 ? 1 : 2;
+            for(int k = 0; k < m.contact_count; ++k)
+            {
+                Contact* c = &m.contacts[k];
+                c->normal = m.normal;
+                c->rel_pos_a = V3(next_float(&random, -20, 20), next_float(&random, -20, 20));
+                c->rel_pos_b = V3(next_float(&random, -20, 20), next_float(&random, -20, 20));
+                c->sum_impulse_contact = next_float(&random, 0, 10);
+                c->sum_impulse_friction = V3(next_float(&random, -1, 1), next_float(&random, -1, 1));
+                prepare_contact(&stores[0], &m, c, 1.0f / 120.0f, true);
+            }
+            prepare_contact_block(&stores[0], &m);
+
+            //NOTE: Some lanes as in the soft step, no block and softened normal rows
+            if(i % 4 == 1)
+            {
+                m.block_solve = false;
+                for(int k = 0; k < m.contact_count; ++k)
+                {
+                    m.contacts[k].mass_scale = next_float(&random, 0.5f, 1);
+                    m.contacts[k].impulse_scale = next_float(&random, 0, 0.5f);
+                }
+            }
+            set_contact_lane(&blocks[0], i, &stores[0], &m, i);
+        }
+
+        stores[1] = stores[0];
+        blocks[1] = blocks[0];
+        for(int i = 0; i < iterations; ++i)
+        {
+            solve_contact_rows(&stores[0], &blocks[0], 1, INTEGRATOR_SCALAR);
+            solve_contact_rows(&stores[1], &blocks[1], 1, path);
+        }
+
+        for(int i = 0; i < stores[0].count; ++i)
+        {
+            difference = max(difference, length(stores[0].velocity[i] - stores[1].velocity[i]));
+            difference = max(difference, fabsf(stores[0].angular_velocity[i] - stores[1].angular_velocity[i]));
+        }
+        for(int k = 0; k < MAX_MANIFOLD_CONTACTS; ++k)
+        {
+            for(int i = 0; i < CONTACT_ROW_LANES; ++i)
+            {
+                difference = max(difference, fabsf(blocks[0].sum_normal[k][i] - blocks[1].sum_normal[k][i]));
+                difference = max(difference, fabsf(blocks[0].sum_tangent[k][i] - blocks[1].sum_tangent[k][i]));
+            }
+        }
+    }
+
+    return difference;
+}
+#endif
+
+int main()
+{
+    IntegratorPath supported = get_supported_integrator_path();
+    printf("supported path %d\n", (int)supported);
+
+    bool ok = true;
+    for(int path = INTEGRATOR_SSE; path <= supported; ++path)
+    {
+        //NOTE: Odd count so the scalar tail runs too
+        float integrator = compare_integrator_paths((IntegratorPath)path, INTEGRATOR_CHECK_BODIES + 3, INTEGRATOR_CHECK_STEPS, 1.0f / 120.0f);
+        ok = ok && integrator <= INTEGRATOR_CHECK_TOLERANCE;
+        printf("path %d integrator difference %g\n", path, integrator);
+
+#ifndef PHYSICS_3D
+        int box_box = compare_box_box_paths((IntegratorPath)path, BOX_BOX_CHECK_PAIRS);
+        ok = ok && box_box == 0;
+        printf("path %d box vs box mismatches %d of %d\n", path, box_box, BOX_BOX_CHECK_PAIRS);
+
+        float rows = compare_contact_row_paths((IntegratorPath)path, CONTACT_CHECK_BLOCKS, 8);
+        ok = ok && rows <= CONTACT_CHECK_TOLERANCE;
+        printf("path %d contact row difference %g\n", path, rows);
+#endif
+    }
+
+    printf(ok ? "all paths match\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
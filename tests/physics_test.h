@@ -0,0 +1,69 @@
+#ifndef PHYSICS_TEST_H
+#define PHYSICS_TEST_H
+
+/*  NOTE: Tests and benchmarks
+    Every file in this folder is its own program built on the physics sources alone, no
+    window, no SDL. They include this header instead of core.h, which brings in the same
+    standard headers and typedefs and then the engine as one translation unit.
+    Build one from the repo root with the same compiler as the game, e.g.
+        cl /O2 /EHsc tests\check_simd_paths.cpp
+    and add /DPHYSICS_3D for the 3D build where the test supports it.
+*/
+
+//NOTE: Everything the engine includes comes before min and max are defined
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <new>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <assert.h>
+
+typedef uint8_t u8;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int s32;
+typedef int64_t s64;
+
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+//NOTE: The game gets these from the windows headers SDL pulls in
+#ifndef min
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a,b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#include "../Engine/math.h"
+#include "../Engine/Physics/physics.cpp"
+
+inline double get_test_time_in_seconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//NOTE: Small LCG so the tests don't depend on the rand() of the platform
+struct TestRandom
+{
+    u32 seed;
+};
+
+inline float next_float(TestRandom* random, float lo, float hi)
+{
+    random->seed = random->seed * 1664525u + 1013904223u;
+    return lo + (hi - lo) * ((random->seed >> 8) * (1.0f / 16777216.0f));
+}
+
+#endif